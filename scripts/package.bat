@@ -26,3 +26,7 @@ dist\bin\boostdep.exe --list-buildable | xz --format=lzma > %OUTDIR%\buildable.t
 FOR /d %%i IN (libs/*) DO tar cf %OUTDIR%\%%i.tar.lzma --lzma libs/%%i/
 
 tar cf %OUTDIR%\build.tar.lzma --lzma b2.exe boost-build.jam boostcpp.jam Jamroot libs/Jamfile.v2 tools/build/
+
+PUSHD %OUTDIR%
+sha256sum *.tar.lzma | xz --format=lzma > sha256.txt.lzma
+POPD
@@ -29,6 +29,16 @@ public:
     // been reached
 
     virtual std::size_t read( void * p, std::size_t n ) = 0;
+
+    // readers that hold the data in memory can return a pointer to the
+    // next n bytes or fewer (0 at the end of the stream) instead of
+    // copying them; the data remains valid until the next call to read or
+    // read_direct. The default returns false, and read must be used instead
+
+    virtual bool read_direct( void const * & /*p*/, std::size_t & /*n*/ )
+    {
+        return false;
+    }
 };
 
 #endif // #ifndef BASIC_READER_HPP_INCLUDED
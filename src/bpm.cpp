@@ -17,6 +17,8 @@
 #include "cmd_index.hpp"
 #include "cmd_remove.hpp"
 #include "cmd_list.hpp"
+#include "cmd_serve.hpp"
+#include "cmd_verify.hpp"
 #include <string>
 #include <exception>
 #include <stdexcept>
@@ -49,7 +51,7 @@ static void usage()
         "  -vv: Be more verbose\n"
         "  -q:  Be quiet\n\n"
 
-        "  bpm install [-n] [+d] [-k] [-a] [-i] [-p] <module> <module>...\n\n"
+        "  bpm install [-n] [+d] [-k] [-a] [-i] [-p] [-j N] [-f N] [-w N] [-s <dirs>] <module> <module>...\n\n"
 
         "    Installs the specified modules and their dependencies into\n"
         "    the current directory.\n\n"
@@ -59,7 +61,13 @@ static void usage()
         "    -k: Do not remove partial installations on error\n"
         "    -a: All modules (use instead of a module list)\n"
         "    -i: Installed modules\n"
-        "    -p: Partially installed modules\n\n"
+        "    -p: Partially installed modules\n"
+        "    -j: Install N packages in parallel\n"
+        "    -f: Download up to N packages ahead (default 2, requires the cache)\n"
+        "    -w: Write files with N threads while decoding (default 0)\n"
+        "    -s: Only extract the listed subdirectories of each package,\n"
+        "        as in -s include,build (meta/ is always extracted); packages\n"
+        "        installed with fewer subdirectories are installed again\n\n"
 
         "  bpm remove [-n] [-f] [-d] [-a] [-p] <package> <package>...\n\n"
 
@@ -90,7 +98,20 @@ static void usage()
         "  bpm index\n\n"
 
         "    Recreates the file index.html, which lists the installed\n"
-        "    modules, in the current directory.\n"
+        "    modules, in the current directory.\n\n"
+
+        "  bpm verify [<package> <package>...]\n\n"
+
+        "    Checks the files of the specified installed packages, or of\n"
+        "    all of them, against the manifests written when they were\n"
+        "    installed, and lists those missing or modified.\n\n"
+
+        "  bpm serve [-p N] <directory>\n\n"
+
+        "    Serves the release in <directory> over HTTP, for use as\n"
+        "    package_path by other machines. Does not read bpm.conf.\n\n"
+
+        "    -p: Listen on port N (default 8080)\n"
 
     );
 }
@@ -107,8 +128,6 @@ int main( int argc, char const * argv[] )
     {
         ++argv;
 
-        config_read_file( "bpm.conf" );
-
         parse_options( argv, handle_option );
 
         if( *argv == 0 )
@@ -118,6 +137,11 @@ int main( int argc, char const * argv[] )
 
         std::string command( *argv++ );
 
+        if( command != "serve" )
+        {
+            config_read_file( "bpm.conf" );
+        }
+
         if( command == "install" )
         {
             cmd_install( argv );
@@ -138,6 +162,14 @@ int main( int argc, char const * argv[] )
         {
             cmd_list( argv );
         }
+        else if( command == "verify" )
+        {
+            cmd_verify( argv );
+        }
+        else if( command == "serve" )
+        {
+            cmd_serve( argv );
+        }
         else if( command == "help" )
         {
             usage();
@@ -0,0 +1,193 @@
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "buffered_reader.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+buffered_reader::buffered_reader( basic_reader * pr, std::size_t size, bool read_ahead ): pr_( pr ), buffer_( size > 0? size: 1 ), head_( 0 ), count_( 0 ), eof_( false ), stop_( false ), th_( 0 )
+{
+    if( read_ahead )
+    {
+        th_ = new thread( thread_proc, this );
+    }
+}
+
+buffered_reader::~buffered_reader()
+{
+    if( th_ )
+    {
+        {
+            scoped_lock lock( mx_ );
+
+            stop_ = true;
+            cn_space_.notify_one();
+        }
+
+        delete th_; // joins
+    }
+}
+
+std::string buffered_reader::name() const
+{
+    return pr_->name();
+}
+
+void buffered_reader::thread_proc( void * pv )
+{
+    static_cast< buffered_reader* >( pv )->fill();
+}
+
+void buffered_reader::fill()
+{
+    std::size_t const size = buffer_.size();
+
+    for( ;; )
+    {
+        std::size_t tail, space;
+
+        {
+            scoped_lock lock( mx_ );
+
+            while( count_ == size && !stop_ )
+            {
+                cn_space_.wait( mx_ );
+            }
+
+            if( stop_ ) return;
+
+            tail = ( head_ + count_ ) % size;
+            space = std::min( size - count_, size - tail );
+        }
+
+        // the free part of the buffer is only accessed by this thread
+
+        std::size_t r = 0;
+
+        try
+        {
+            r = pr_->read( &buffer_[ tail ], space );
+        }
+        catch( std::exception const & x )
+        {
+            scoped_lock lock( mx_ );
+
+            error_ = x.what();
+            cn_data_.notify_one();
+
+            return;
+        }
+
+        {
+            scoped_lock lock( mx_ );
+
+            if( r == 0 )
+            {
+                eof_ = true;
+                cn_data_.notify_one();
+
+                return;
+            }
+
+            count_ += r;
+            cn_data_.notify_one();
+        }
+    }
+}
+
+std::size_t buffered_reader::read_buffered( void * p, std::size_t n )
+{
+    // copies out of the contiguous part of the buffered data
+
+    std::size_t k = std::min( n, std::min( count_, buffer_.size() - head_ ) );
+
+    std::memcpy( p, &buffer_[ head_ ], k );
+
+    head_ = ( head_ + k ) % buffer_.size();
+    count_ -= k;
+
+    return k;
+}
+
+bool buffered_reader::wait( double seconds )
+{
+    if( th_ )
+    {
+        scoped_lock lock( mx_ );
+
+        if( count_ == 0 && !eof_ && error_.empty() )
+        {
+            cn_data_.wait_for( mx_, seconds );
+        }
+
+        return count_ != 0 || eof_ || !error_.empty();
+    }
+
+    return count_ != 0 || eof_;
+}
+
+std::size_t buffered_reader::read( void * p, std::size_t n )
+{
+    if( n == 0 ) return 0;
+
+    if( th_ )
+    {
+        scoped_lock lock( mx_ );
+
+        while( count_ == 0 && !eof_ && error_.empty() )
+        {
+            cn_data_.wait( mx_ );
+        }
+
+        if( count_ == 0 )
+        {
+            if( !error_.empty() )
+            {
+                throw std::runtime_error( error_ );
+            }
+
+            return 0;
+        }
+
+        std::size_t r = read_buffered( p, n );
+
+        cn_space_.notify_one();
+
+        return r;
+    }
+
+    if( count_ == 0 )
+    {
+        if( eof_ )
+        {
+            return 0;
+        }
+
+        if( n >= buffer_.size() )
+        {
+            // large read, bypass the buffer
+
+            std::size_t r = pr_->read( p, n );
+
+            eof_ = r == 0;
+            return r;
+        }
+
+        head_ = 0;
+        count_ = pr_->read( &buffer_[ 0 ], buffer_.size() );
+
+        if( count_ == 0 )
+        {
+            eof_ = true;
+            return 0;
+        }
+    }
+
+    return read_buffered( p, n );
+}
@@ -0,0 +1,71 @@
+#ifndef BUFFERED_READER_HPP_INCLUDED
+#define BUFFERED_READER_HPP_INCLUDED
+
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "basic_reader.hpp"
+#include "thread.hpp"
+#include <vector>
+
+// reads from 'pr' in blocks of up to 'size' bytes, so that small reads
+// are served from memory. With 'read_ahead', the buffer is filled by a
+// background thread, so that reading 'pr' overlaps with the processing
+// of the data. In that case, the owner of 'pr' must make sure that a
+// pending read completes before the buffered_reader is destroyed, for
+// instance by shutting down the socket.
+
+class buffered_reader: public basic_reader
+{
+private:
+
+    basic_reader * pr_;
+
+    std::vector< char > buffer_;
+
+    std::size_t head_;
+    std::size_t count_;
+
+    bool eof_;
+
+    // read-ahead state
+
+    mutex mx_;
+    condition cn_data_;
+    condition cn_space_;
+
+    bool stop_;
+    std::string error_;
+
+    thread * th_;
+
+private:
+
+    buffered_reader( buffered_reader const & );
+    buffered_reader& operator=( buffered_reader const & );
+
+    static void thread_proc( void * pv );
+    void fill();
+
+    std::size_t read_buffered( void * p, std::size_t n );
+
+public:
+
+    buffered_reader( basic_reader * pr, std::size_t size, bool read_ahead );
+    virtual ~buffered_reader();
+
+    virtual std::string name() const;
+    virtual std::size_t read( void * p, std::size_t n );
+
+    // returns true when a read would not block. With read-ahead, waits up
+    // to 'seconds' for data; otherwise, only checks the buffer, and the
+    // caller needs to check 'pr' as well
+    bool wait( double seconds );
+};
+
+#endif // #ifndef BUFFERED_READER_HPP_INCLUDED
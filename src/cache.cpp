@@ -0,0 +1,285 @@
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "cache.hpp"
+#include "config.hpp"
+#include "message.hpp"
+#include "package_path.hpp"
+#include "fs.hpp"
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <errno.h>
+
+#if defined( _WIN32 )
+# include <process.h>
+# define getpid _getpid
+#else
+# include <unistd.h>
+#endif
+
+static std::string default_cache_path()
+{
+#if defined( _WIN32 )
+
+    char const * p = std::getenv( "LOCALAPPDATA" );
+
+    if( p && *p )
+    {
+        return std::string( p ) + "/bpm/cache";
+    }
+
+#else
+
+    char const * p = std::getenv( "XDG_CACHE_HOME" );
+
+    if( p && *p )
+    {
+        return std::string( p ) + "/bpm";
+    }
+
+    p = std::getenv( "HOME" );
+
+    if( p && *p )
+    {
+        return std::string( p ) + "/.cache/bpm";
+    }
+
+#endif
+
+    return std::string();
+}
+
+static std::string release_hash( std::string const & package_path )
+{
+    // FNV-1a
+
+    unsigned long long h = 14695981039346656037ULL;
+
+    for( std::size_t i = 0, n = package_path.size(); i < n; ++i )
+    {
+        h ^= static_cast< unsigned char >( package_path[ i ] );
+        h *= 1099511628211ULL;
+    }
+
+    char buffer[ 32 ];
+    std::sprintf( buffer, "%016llx", h );
+
+    return buffer;
+}
+
+static bool create_directories( std::string const & path )
+{
+    for( std::size_t i = path.find( '/', 1 ); ; i = path.find( '/', i + 1 ) )
+    {
+        std::string p2 = path.substr( 0, i );
+
+        if( !p2.empty() && !fs_exists( p2 ) && fs_mkdir( p2, 0755 ) != 0 && errno != EEXIST )
+        {
+            msg_printf( 1, "'%s': create error: %s", p2.c_str(), std::strerror( errno ) );
+            return false;
+        }
+
+        if( i == std::string::npos ) break;
+    }
+
+    return true;
+}
+
+std::string cache_get_path( std::string const & package_path )
+{
+    if( package_path_is_local( package_path ) )
+    {
+        // local archives are read in place
+        return std::string();
+    }
+
+    std::string path = config_get_option( "cache_path" );
+
+    if( path == "none" )
+    {
+        return std::string();
+    }
+
+    if( path.empty() )
+    {
+        path = default_cache_path();
+
+        if( path.empty() )
+        {
+            return std::string();
+        }
+    }
+
+    if( *path.rbegin() != '/' )
+    {
+        path += '/';
+    }
+
+    path += release_hash( package_path ) + '/';
+
+    if( !create_directories( path ) )
+    {
+        msg_printf( 1, "download cache disabled" );
+        return std::string();
+    }
+
+    return path;
+}
+
+std::string cache_temp_name( std::string const & path )
+{
+    char buffer[ 32 ];
+    std::sprintf( buffer, ".%d.part", static_cast< int >( getpid() ) );
+
+    return path + buffer;
+}
+
+long long cache_claim_partial( std::string const & path, std::string & validator )
+{
+    std::string partial = path + ".partial";
+
+    if( !fs_exists( partial ) )
+    {
+        return 0;
+    }
+
+    std::string temp = cache_temp_name( path );
+
+    // the rename fails when another process has claimed it first
+
+    if( fs_rename( partial, temp ) != 0 )
+    {
+        return 0;
+    }
+
+    long long size = fs_size( temp );
+
+    if( size <= 0 )
+    {
+        std::remove( temp.c_str() );
+        return 0;
+    }
+
+    validator.clear();
+
+    if( std::FILE * f = std::fopen( ( partial + ".meta" ).c_str(), "r" ) )
+    {
+        char buffer[ 256 ];
+
+        if( std::fgets( buffer, sizeof( buffer ), f ) )
+        {
+            validator = buffer;
+
+            if( !validator.empty() && *validator.rbegin() == '\n' )
+            {
+                validator.resize( validator.size() - 1 );
+            }
+        }
+
+        std::fclose( f );
+    }
+
+    return size;
+}
+
+void cache_keep_validator( std::string const & path, std::string const & validator )
+{
+    std::string meta = path + ".partial.meta";
+
+    if( validator.empty() )
+    {
+        std::remove( meta.c_str() );
+        return;
+    }
+
+    std::FILE * f = std::fopen( meta.c_str(), "w" );
+
+    if( f == 0 )
+    {
+        msg_printf( 1, "'%s': create error: %s", meta.c_str(), std::strerror( errno ) );
+        return;
+    }
+
+    std::fprintf( f, "%s\n", validator.c_str() );
+
+    if( std::fclose( f ) != 0 )
+    {
+        msg_printf( 1, "'%s': write error: %s", meta.c_str(), std::strerror( errno ) );
+        std::remove( meta.c_str() );
+    }
+}
+
+void cache_set_release( std::string const & path, std::string const & release )
+{
+    if( path.empty() || release.empty() )
+    {
+        return;
+    }
+
+    std::string fn = path + "release";
+
+    std::string old;
+
+    {
+        std::ifstream is( fn.c_str() );
+        std::getline( is, old );
+    }
+
+    if( old == release )
+    {
+        return;
+    }
+
+    // archives cached before the version was recorded are of an unknown
+    // version, and go too
+
+    msg_printf( 1, "the release has changed, removing its cached archives" );
+
+    std::vector< std::string > entries;
+    fs_readdir( path, entries );
+
+    for( std::vector< std::string >::const_iterator i = entries.begin(); i != entries.end(); ++i )
+    {
+        // name.tar.lzma, name.tar.xz.partial, name.tar.zst.partial.meta...
+        if( i->find( ".tar." ) == std::string::npos ) continue;
+
+        std::string p2 = path + *i;
+
+        if( std::remove( p2.c_str() ) == 0 )
+        {
+            msg_printf( 2, "removing '%s'", p2.c_str() );
+        }
+        else
+        {
+            msg_printf( 1, "'%s': remove error: %s", p2.c_str(), std::strerror( errno ) );
+        }
+    }
+
+    // the format of the archives may have changed too
+
+    std::remove( ( path + "archive_format" ).c_str() );
+
+    std::FILE * f = std::fopen( fn.c_str(), "w" );
+
+    if( f == 0 )
+    {
+        msg_printf( 1, "'%s': create error: %s", fn.c_str(), std::strerror( errno ) );
+        return;
+    }
+
+    std::fprintf( f, "%s\n", release.c_str() );
+
+    if( std::fclose( f ) != 0 )
+    {
+        msg_printf( 1, "'%s': write error: %s", fn.c_str(), std::strerror( errno ) );
+        std::remove( fn.c_str() );
+    }
+}
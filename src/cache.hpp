@@ -0,0 +1,49 @@
+#ifndef CACHE_HPP_INCLUDED
+#define CACHE_HPP_INCLUDED
+
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <string>
+
+// returns the directory, ending in '/', in which files of the release at
+// 'package_path' are cached, creating it if necessary; returns an empty
+// string when caching is disabled (cache_path=none in bpm.conf) or
+// 'package_path' is local
+
+std::string cache_get_path( std::string const & package_path );
+
+// returns a name for a temporary file that will be renamed to 'path'
+// once complete, unique to the current process
+
+std::string cache_temp_name( std::string const & path );
+
+// takes over a partial download of 'path' left by an earlier run, by
+// renaming it to cache_temp_name( path ); returns its size, or 0 when
+// there is none. 'validator' receives the one kept with it, if any
+
+long long cache_claim_partial( std::string const & path, std::string & validator );
+
+// keeps 'validator', the ETag or Last-Modified value of the response from
+// which a partial download of 'path' comes, as path + ".partial.meta", so
+// that resuming it can be made conditional on If-Range; an empty one
+// removes it
+
+void cache_keep_validator( std::string const & path, std::string const & validator );
+
+// records 'release', which identifies the version of the release whose
+// files are cached in the directory 'path' (the ETag or Last-Modified
+// value of its dependencies.txt). When it differs from the one recorded,
+// the archives cached for the other version, and the record of their
+// format, are removed first, so that
+// a release rebuilt at the same URL isn't served from stale copies. An
+// empty 'release' can't be compared, and changes nothing
+
+void cache_set_release( std::string const & path, std::string const & release );
+
+#endif // #ifndef CACHE_HPP_INCLUDED
@@ -11,8 +11,11 @@
 #include "message.hpp"
 #include "error.hpp"
 #include "fs.hpp"
+#include "manifest.hpp"
+#include "string.hpp"
 #include <stdexcept>
 #include <map>
+#include <utility>
 #include <cassert>
 #include <errno.h>
 
@@ -54,27 +57,79 @@ static void rmerror( std::string const & path, int err )
     throw_errno_error( path, "remove error", err );
 }
 
-static void build_dir_map2( std::string const & path, std::string const & suffix, std::map< std::string, std::vector< std::string > > & dirs )
+// the contents of the directories of the installed packages, as
+// (name, is directory) pairs, from their manifests, so that they
+// needn't be read from disk
+
+typedef std::vector< std::pair< std::string, bool > > directory_listing;
+
+static std::map< std::string, directory_listing > s_listings;
+
+static void read_listings( std::string const & path )
 {
-    // enumerate header directories in 'path' + 'suffix'
+    std::vector< manifest_entry > manifest;
 
-    std::vector< std::string > entries;
-    int r = fs_readdir( path + suffix, entries );
+    if( !fs_exists( path + "/.installed" ) || !manifest_read( path + "/.manifest", manifest ) )
+    {
+        return;
+    }
+
+    for( std::vector< manifest_entry >::const_iterator i = manifest.begin(); i != manifest.end(); ++i )
+    {
+        std::string p = i->path;
+        remove_trailing( p, '/' );
+
+        std::size_t j = p.rfind( '/' );
+
+        if( j == std::string::npos ) continue;
+
+        s_listings[ p.substr( 0, j ) ].push_back( std::make_pair( p.substr( j + 1 ), i->type == 'd' ) );
+    }
+}
+
+// lists the directory 'path', from the manifests when they have it
+static void list_directory( std::string const & path, directory_listing & entries )
+{
+    std::map< std::string, directory_listing >::const_iterator i = s_listings.find( path );
+
+    if( i != s_listings.end() )
+    {
+        entries = i->second;
+        return;
+    }
+
+    std::vector< std::string > names;
+    int r = fs_readdir( path, names );
 
     if( r != 0 )
     {
-        throw_errno_error( path + suffix, "read error", errno );
+        throw_errno_error( path, "read error", errno );
     }
 
-    for( std::vector< std::string >::const_iterator i = entries.begin(); i != entries.end(); ++i )
+    entries.clear();
+
+    for( std::vector< std::string >::const_iterator j = names.begin(); j != names.end(); ++j )
     {
-        if( *i == "." || *i == ".." ) continue;
+        if( *j == "." || *j == ".." ) continue;
+
+        entries.push_back( std::make_pair( *j, fs_is_dir( path + "/" + *j ) ) );
+    }
+}
+
+static void build_dir_map2( std::string const & path, std::string const & suffix, std::map< std::string, std::vector< std::string > > & dirs )
+{
+    // enumerate header directories in 'path' + 'suffix'
 
-        std::string sx2 = suffix + "/" + *i;
+    directory_listing entries;
+    list_directory( path + suffix, entries );
 
-        std::string p2 = path + sx2;
+    for( directory_listing::const_iterator i = entries.begin(); i != entries.end(); ++i )
+    {
+        if( !i->second ) continue;
 
-        if( !fs_is_dir( p2 ) ) continue;
+        std::string sx2 = suffix + "/" + i->first;
+
+        std::string p2 = path + sx2;
 
         dirs[ sx2 ].push_back( p2 );
 
@@ -100,6 +155,8 @@ static void build_dir_map( std::string const & path, std::map< std::string, std:
 
         std::string p2 = path + "/" + *i;
 
+        read_listings( p2 );
+
         if( fs_is_dir( p2 ) && fs_is_dir( p2 + "/include" ) )
         {
             build_dir_map2( p2 + "/", "include", dirs );
@@ -119,22 +176,15 @@ static void link_files( std::string const & path, std::string const & target, st
 {
     // msg_printf( 1, "linking files from '%s' into '%s'", path.c_str(), target.c_str() );
 
-    std::vector< std::string > entries;
-    int r = fs_readdir( path, entries );
+    directory_listing entries;
+    list_directory( path, entries );
 
-    if( r != 0 )
+    for( directory_listing::const_iterator i = entries.begin(); i != entries.end(); ++i )
     {
-        throw_errno_error( path, "read error", errno );
-    }
+        std::string p2 = path + "/" + i->first;
+        std::string t2 = target + "/" + i->first;
 
-    for( std::vector< std::string >::const_iterator i = entries.begin(); i != entries.end(); ++i )
-    {
-        if( *i == "." || *i == ".." ) continue;
-
-        std::string p2 = path + "/" + *i;
-        std::string t2 = target + "/" + *i;
-
-        if( fs_is_dir( p2 ) )
+        if( i->second )
         {
             link_directory( t2, dirs );
         }
@@ -217,14 +267,21 @@ static void link_directory( std::string const & dir, std::map< std::string, std:
     remove_directory_from_list( dir, dirs );
 }
 
-static void remove_directory( std::string const & dir )
+static void rmerror_existing( std::string const & path, int err )
 {
-    if( fs_exists( dir ) )
+    if( err != ENOENT )
     {
-        fs_remove_all( dir, removing, rmerror );
+        rmerror( path, err );
     }
 }
 
+static void remove_directory( std::string const & dir )
+{
+    // not checked with fs_exists, which is false for a link whose
+    // target has been removed
+    fs_remove_all( dir, removing, rmerror_existing );
+}
+
 static void touch_file( std::string const & path )
 {
     int fd = fs_creat( path, 0644 );
@@ -241,14 +298,17 @@ void cmd_headers()
 
     msg_printf( 1, "removing old header links" );
 
-    remove_directory( "include" );
+    // 'boost' first, as it's a link into 'include'
     remove_directory( "boost" );
+    remove_directory( "include" );
 
     if( !fs_exists( "libs" ) )
     {
         return;
     }
 
+    s_listings.clear();
+
     std::map< std::string, std::vector< std::string > > dirs;
     build_dir_map( "libs", dirs );
 
@@ -14,15 +14,27 @@
 #include "cmd_index.hpp"
 
 #include "lzma_reader.hpp"
+#include "xz_reader.hpp"
+#include "zstd_reader.hpp"
 #include "http_reader.hpp"
+#include "file_reader.hpp"
+#include "mmap_reader.hpp"
+#include "tee_reader.hpp"
+#include "sha256_reader.hpp"
+#include "cache.hpp"
+#include "string.hpp"
 #include "tar.hpp"
+#include "manifest.hpp"
 
 #include "error.hpp"
 #include "fs.hpp"
+#include "thread.hpp"
 
 #include <algorithm>
 #include <stdexcept>
+#include <fstream>
 #include <cstdio>
+#include <cstdlib>
 #include <cstddef>
 #include <cstring>
 #include <errno.h>
@@ -34,6 +46,21 @@ static bool s_opt_k = false;
 static bool s_opt_a = false;
 static bool s_opt_i = false;
 static bool s_opt_p = false;
+static int s_opt_j = 1;
+static int s_opt_f = 2;
+static int s_opt_w = 0;
+
+// the subtrees of each package to extract, from -s; empty for all
+static std::set< std::string > s_opt_s;
+
+// download cache directory for the release, empty when disabled
+static std::string s_cache_path;
+
+// the SHA-256 digests of the archives, by file name; empty when the
+// release has none. Retrieved with the first archive that is extracted
+static mutex s_digests_mx;
+static bool s_digests_retrieved;
+static std::map< std::string, std::string > s_digests;
 
 static void handle_option( std::string const & opt )
 {
@@ -65,6 +92,50 @@ static void handle_option( std::string const & opt )
     {
         s_opt_p = true;
     }
+    else if( opt.substr( 0, 2 ) == "-j" )
+    {
+        s_opt_j = std::atoi( opt.c_str() + 2 );
+
+        if( s_opt_j < 1 )
+        {
+            throw std::runtime_error( "invalid install option: '" + opt + "'" );
+        }
+    }
+    else if( opt.substr( 0, 2 ) == "-f" )
+    {
+        s_opt_f = std::atoi( opt.c_str() + 2 );
+
+        if( s_opt_f < 0 || ( s_opt_f == 0 && opt != "-f0" ) )
+        {
+            throw std::runtime_error( "invalid install option: '" + opt + "'" );
+        }
+    }
+    else if( opt.substr( 0, 2 ) == "-w" )
+    {
+        s_opt_w = std::atoi( opt.c_str() + 2 );
+
+        if( s_opt_w < 0 || ( s_opt_w == 0 && opt != "-w0" ) )
+        {
+            throw std::runtime_error( "invalid install option: '" + opt + "'" );
+        }
+    }
+    else if( opt.substr( 0, 2 ) == "-s" )
+    {
+        std::string v = opt.substr( 2 ) + ',';
+
+        for( std::size_t i = 0, j = v.find( ',' ); j != std::string::npos; i = j + 1, j = v.find( ',', i ) )
+        {
+            std::string name = v.substr( i, j - i );
+            remove_trailing( name, '/' );
+
+            if( name.empty() || name.find( '/' ) != std::string::npos || name == "." || name == ".." )
+            {
+                throw std::runtime_error( "invalid install option: '" + opt + "'" );
+            }
+
+            s_opt_s.insert( name );
+        }
+    }
     else if( opt == "-v" )
     {
         increase_message_level();
@@ -89,12 +160,21 @@ static void rmerror( std::string const & path, int err )
     msg_printf( 1, "'%s': remove error: %s", path.c_str(), std::strerror( err ) );
 }
 
-static void remove_partial_installation( std::string const & module, std::string const & path, std::set< std::string > const & files )
+// removes the entries of 'manifest', those extracted so far, and then
+// scans 'path' for anything else
+
+static void remove_partial_installation( std::string const & module, std::string const & path, std::set< std::string > const & files, std::vector< manifest_entry > const & manifest )
 {
-    if( fs_exists( path ) )
+    if( !manifest.empty() || fs_exists( path ) )
     {
         msg_printf( 1, "removing partial installation of module '%s'", module.c_str() );
-        fs_remove_all( path, removing, rmerror );
+
+        manifest_remove( manifest, removing, rmerror );
+
+        if( fs_exists( path ) )
+        {
+            fs_remove_all( path, removing, rmerror );
+        }
     }
 
     for( std::set< std::string >::const_iterator i = files.begin(); i != files.end(); ++i )
@@ -113,16 +193,94 @@ static void remove_partial_installation( std::string const & module, std::string
     }
 }
 
-static void touch_file( std::string const & path )
+// the subtrees of the package directory 'path' to extract; -s doesn't
+// apply to tools/build, which b2 needs whole
+
+static std::set< std::string > module_subtrees( std::string const & path )
 {
+    if( path.substr( 0, 5 ) == "libs/" )
+    {
+        return s_opt_s;
+    }
+
+    return std::set< std::string >();
+}
+
+// the marker records the subtrees that have been extracted, as a line
+// "subtrees=include,build"; it's empty when the package was extracted
+// whole
+
+static void write_marker( std::string const & path, std::set< std::string > const & subtrees )
+{
+    std::string data;
+
+    if( !subtrees.empty() )
+    {
+        data = "subtrees=";
+
+        for( std::set< std::string >::const_iterator i = subtrees.begin(); i != subtrees.end(); ++i )
+        {
+            if( i != subtrees.begin() ) data += ',';
+            data += *i;
+        }
+
+        data += '\n';
+    }
+
     int fd = fs_creat( path, 0644 );
 
     if( fd >= 0 )
     {
+        if( !data.empty() )
+        {
+            fs_write( fd, data.data(), static_cast< unsigned >( data.size() ) );
+        }
+
         fs_close( fd );
     }
 }
 
+static std::set< std::string > read_marker( std::string const & path )
+{
+    std::set< std::string > subtrees;
+
+    std::ifstream is( path.c_str() );
+
+    std::string line;
+
+    if( std::getline( is, line ) && line.substr( 0, 9 ) == "subtrees=" )
+    {
+        std::string v = line.substr( 9 ) + ',';
+
+        for( std::size_t i = 0, j = v.find( ',' ); j != std::string::npos; i = j + 1, j = v.find( ',', i ) )
+        {
+            if( j > i )
+            {
+                subtrees.insert( v.substr( i, j - i ) );
+            }
+        }
+    }
+
+    return subtrees;
+}
+
+// whether the package directory 'path', installed with the subtrees
+// recorded in 'marker', lacks some of those now selected
+
+static bool needs_reinstall( std::string const & path, std::string const & marker )
+{
+    std::set< std::string > installed = read_marker( marker );
+
+    if( installed.empty() )
+    {
+        return false;
+    }
+
+    std::set< std::string > selected = module_subtrees( path );
+
+    return selected.empty() || !std::includes( installed.begin(), installed.end(), selected.begin(), selected.end() );
+}
+
 static std::string module_package( std::string const & module )
 {
     std::size_t i = module.find( '~' );
@@ -132,6 +290,314 @@ static std::string module_package( std::string const & module )
     return package;
 }
 
+// the format of the package archives; a release provides .tar.zst
+// archives, which decode fastest, .tar.xz ones, which can be decoded
+// in parallel, or .tar.lzma ones. Every release has the 'build'
+// package, so its archive determines the format. The format found is
+// kept in the cache, along with the archives of the release
+
+static char const * const s_archive_formats[] = { ".tar.zst", ".tar.xz", ".tar.lzma" };
+
+static mutex s_archive_mx;
+static std::string s_archive_ext;
+
+static bool archive_exists( std::string const & package_path, std::string const & ext )
+{
+    if( package_path_is_local( package_path ) )
+    {
+        return fs_exists( package_file_name( package_path + "build" + ext ) );
+    }
+
+    if( !s_cache_path.empty() && fs_exists( s_cache_path + "build" + ext ) )
+    {
+        return true;
+    }
+
+    try
+    {
+        http_reader r1( package_path + "build" + ext, "Range: bytes=0-0\r\n" );
+        return true;
+    }
+    catch( std::exception const & x )
+    {
+        // only a 404 says that the format is absent; anything else
+        // would pick the wrong format for the whole release
+
+        if( !http_is_not_found( x ) )
+        {
+            throw;
+        }
+
+        msg_printf( 2, "%s", x.what() );
+        return false;
+    }
+}
+
+static std::string archive_ext( std::string const & package_path )
+{
+    scoped_lock lock( s_archive_mx );
+
+    if( !s_archive_ext.empty() )
+    {
+        return s_archive_ext;
+    }
+
+    std::size_t const n = sizeof( s_archive_formats ) / sizeof( s_archive_formats[ 0 ] );
+
+    std::string const fn = s_cache_path.empty() || package_path_is_local( package_path )? std::string(): s_cache_path + "archive_format";
+
+    if( !fn.empty() )
+    {
+        std::string ext;
+
+        {
+            std::ifstream is( fn.c_str() );
+            std::getline( is, ext );
+        }
+
+        if( std::find( s_archive_formats, s_archive_formats + n, ext ) != s_archive_formats + n )
+        {
+            s_archive_ext = ext;
+
+            msg_printf( 1, "using '%s' archives", s_archive_ext.c_str() );
+            return s_archive_ext;
+        }
+    }
+
+    // the last format is assumed when the others aren't there
+
+    std::size_t i = 0;
+
+    while( i + 1 < n && !archive_exists( package_path, s_archive_formats[ i ] ) )
+    {
+        ++i;
+    }
+
+    s_archive_ext = s_archive_formats[ i ];
+
+    msg_printf( 1, "using '%s' archives", s_archive_ext.c_str() );
+
+    if( !fn.empty() )
+    {
+        std::ofstream os( fn.c_str() );
+        os << s_archive_ext << '\n';
+
+        if( !os )
+        {
+            msg_printf( 1, "'%s': write error", fn.c_str() );
+        }
+    }
+
+    return s_archive_ext;
+}
+
+static std::string archive_digest( std::string const & tar_name )
+{
+    scoped_lock lock( s_digests_mx );
+
+    if( !s_digests_retrieved )
+    {
+        retrieve_digests( s_digests );
+        s_digests_retrieved = true;
+    }
+
+    if( s_digests.empty() )
+    {
+        return std::string();
+    }
+
+    std::map< std::string, std::string >::const_iterator i = s_digests.find( tar_name );
+
+    if( i == s_digests.end() )
+    {
+        msg_printf( 1, "'%s' has no SHA-256 digest, not verifying", tar_name.c_str() );
+        return std::string();
+    }
+
+    return i->second;
+}
+
+static void extract_archive( basic_reader * pr, std::string const & path, std::set< std::string > const & whitelist, std::vector< manifest_entry > & manifest )
+{
+    std::set< std::string > subtrees = module_subtrees( path );
+
+    if( s_archive_ext == ".tar.zst" )
+    {
+        zstd_reader r2( pr );
+        tar_extract( &r2, path + '/', whitelist, subtrees, s_opt_w, manifest );
+    }
+    else if( s_archive_ext == ".tar.xz" )
+    {
+        xz_reader r2( pr );
+        tar_extract( &r2, path + '/', whitelist, subtrees, s_opt_w, manifest );
+    }
+    else
+    {
+        lzma_reader r2( pr );
+        tar_extract( &r2, path + '/', whitelist, subtrees, s_opt_w, manifest );
+    }
+}
+
+// extracts the archive and writes the manifest and the marker; when
+// 'digest' isn't empty, the archive is hashed as it's read, and a
+// mismatch is an error, so the module is left without a marker and
+// removed
+
+static void extract_module( basic_reader * pr, std::string const & module, std::string const & path, std::set< std::string > const & whitelist, std::string const & marker, std::string const & digest )
+{
+    std::vector< manifest_entry > manifest;
+
+    try
+    {
+        if( digest.empty() )
+        {
+            extract_archive( pr, path, whitelist, manifest );
+        }
+        else
+        {
+            sha256_reader r2( pr );
+
+            extract_archive( &r2, path, whitelist, manifest );
+
+            if( r2.hex_digest() != digest )
+            {
+                throw_error( pr->name(), "SHA-256 digest mismatch" );
+            }
+
+            msg_printf( 2, "'%s': SHA-256 digest verified", pr->name().c_str() );
+        }
+
+        manifest_write( path + "/.manifest", manifest );
+
+        write_marker( marker, module_subtrees( path ) );
+    }
+    catch( std::exception const & )
+    {
+        if( !s_opt_k )
+        {
+            remove_partial_installation( module, path, whitelist, manifest );
+        }
+
+        throw;
+    }
+}
+
+// whether 'x' is an error in the archive 'name' itself (a decoder, format
+// or digest error), as opposed to one in creating the extracted files
+
+static bool is_archive_error( std::exception const & x, std::string const & name )
+{
+    error const * pe = dynamic_cast< error const* >( &x );
+    return pe && pe->name() == name;
+}
+
+// whether the 206 response 'r' holds the range starting at 'offset'
+static bool range_starts_at( http_reader const & r, long long offset )
+{
+    std::string range = r.header( "content-range" ); // bytes first-last/length
+    return range.substr( 0, 6 ) == "bytes " && std::strtoll( range.c_str() + 6, 0, 10 ) == offset;
+}
+
+// resumes a download interrupted in an earlier run, if any, with a Range
+// request, conditional on If-Range when the partial download has a
+// validator; returns false when there's nothing to resume
+
+static bool resume_module( std::string const & url, std::string const & cached, std::string const & module, std::string const & path, std::set< std::string > const & whitelist, std::string const & marker, std::string const & digest )
+{
+    std::string validator;
+    long long offset = cache_claim_partial( cached, validator );
+
+    if( offset == 0 )
+    {
+        return false;
+    }
+
+    std::string temp = cache_temp_name( cached );
+
+    char buffer[ 64 ];
+    std::sprintf( buffer, "Range: bytes=%lld-\r\n", offset );
+
+    std::string headers = buffer;
+
+    if( !validator.empty() )
+    {
+        headers += "If-Range: " + validator + "\r\n";
+    }
+
+    try
+    {
+        http_reader r1( url, headers );
+
+        if( r1.status() == 206 && !range_starts_at( r1, offset ) )
+        {
+            msg_printf( -1, "'%s': unexpected Content-Range '%s', discarding partial download", url.c_str(), r1.header( "content-range" ).c_str() );
+
+            std::remove( temp.c_str() );
+            return false;
+        }
+
+        if( r1.status() == 206 )
+        {
+            msg_printf( 1, "resuming download of '%s' at offset %lld", url.c_str(), offset );
+
+            tee_reader r2( &r1, cached, temp, offset );
+            r2.set_validator( validator );
+
+            extract_module( &r2, module, path, whitelist, marker, digest );
+
+            r2.commit();
+            return true;
+        }
+
+        std::remove( temp.c_str() );
+
+        if( r1.status() != 200 )
+        {
+            // 416, the partial download is no longer valid
+            return false;
+        }
+
+        // the server doesn't support ranges, or the file has changed
+        msg_printf( 1, "'%s': partial download can't be resumed, restarting download", url.c_str() );
+
+        tee_reader r2( &r1, cached );
+        r2.set_validator( r1.validator() );
+
+        extract_module( &r2, module, path, whitelist, marker, digest );
+
+        r2.commit();
+        return true;
+    }
+    catch( std::exception const & x )
+    {
+        if( fs_exists( temp ) )
+        {
+            // the request has failed, keep the partial download for the next run
+            fs_rename( temp, cached + ".partial" );
+            throw;
+        }
+
+        if( fs_exists( marker ) )
+        {
+            // only storing the cache copy has failed
+            return true;
+        }
+
+        if( fs_exists( cached + ".partial" ) || s_opt_k )
+        {
+            // a transfer error; tee_reader has kept the partial download
+            throw;
+        }
+
+        // the partial download is damaged, start over
+
+        msg_printf( -1, "%s", x.what() );
+        msg_printf( -1, "discarding partial download of '%s'", url.c_str() );
+
+        return false;
+    }
+}
+
 static void install_module( std::string const & package_path, std::string const & module, std::set< std::string > & installed, std::time_t & mtime )
 {
     std::string package = module_package( module );
@@ -158,36 +624,111 @@ static void install_module( std::string const & package_path, std::string const
 
     std::string marker = path + "/.installed";
 
-    if( !fs_exists( marker ) )
+    // a package installed with -s is installed again when more of it
+    // is selected now
+
+    bool reinstall = fs_exists( marker ) && needs_reinstall( path, marker );
+
+    if( !fs_exists( marker ) || reinstall )
     {
         if( s_opt_n )
         {
-            msg_printf( 0, "would have installed module '%s'", module.c_str() );
+            msg_printf( 0, "would have %s module '%s'", reinstall? "reinstalled": "installed", module.c_str() );
         }
         else
         {
-            remove_partial_installation( module, path, whitelist );
+            if( reinstall )
+            {
+                msg_printf( 1, "module '%s' was installed with fewer subtrees", module.c_str() );
 
-            msg_printf( 0, "installing module '%s'", module.c_str() );
+                // without the marker, an interrupted reinstallation is
+                // cleaned up by the next run
 
-            std::string tar_path = package_path + package + ".tar.lzma";
+                if( std::remove( marker.c_str() ) != 0 )
+                {
+                    throw_errno_error( marker, "remove error", errno );
+                }
+            }
 
-            http_reader r1( tar_path );
-            lzma_reader r2( &r1 );
+            // a manifest without a marker is left when an installation
+            // is interrupted just before its end
 
-            try
+            std::vector< manifest_entry > manifest;
+            manifest_read( path + "/.manifest", manifest );
+
+            remove_partial_installation( module, path, whitelist, manifest );
+
+            msg_printf( 0, "%s module '%s'", reinstall? "reinstalling": "installing", module.c_str() );
+
+            std::string tar_name = package + archive_ext( package_path );
+
+            std::string digest = archive_digest( tar_name );
+
+            std::string cached;
+
+            if( !s_cache_path.empty() )
             {
-                tar_extract( &r2, path + '/', whitelist );
-                touch_file( marker );
+                cached = s_cache_path + tar_name;
             }
-            catch( std::exception const & )
+
+            bool done = false;
+
+            if( package_path_is_local( package_path ) )
             {
-                if( !s_opt_k )
+                mmap_reader r1( package_file_name( package_path + tar_name ) );
+                extract_module( &r1, module, path, whitelist, marker, digest );
+
+                done = true;
+            }
+
+            if( !done && !cached.empty() && fs_exists( cached ) )
+            {
+                msg_printf( 1, "using cached '%s'", cached.c_str() );
+
+                try
                 {
-                    remove_partial_installation( module, path, whitelist );
+                    file_reader r1( cached );
+                    extract_module( &r1, module, path, whitelist, marker, digest );
+
+                    done = true;
                 }
+                catch( std::exception const & x )
+                {
+                    if( !is_archive_error( x, cached ) )
+                    {
+                        // the cached archive is fine
+                        throw;
+                    }
 
-                throw;
+                    // a damaged cache entry; remove it and download again
+
+                    msg_printf( -1, "%s", x.what() );
+                    msg_printf( -1, "removing damaged cache file '%s'", cached.c_str() );
+
+                    std::remove( cached.c_str() );
+
+                    if( s_opt_k )
+                    {
+                        throw;
+                    }
+                }
+            }
+
+            if( !done && !cached.empty() )
+            {
+                done = resume_module( package_path + tar_name, cached, module, path, whitelist, marker, digest );
+            }
+
+            if( !done )
+            {
+                http_reader r1( package_path + tar_name );
+
+                tee_reader r2( &r1, cached );
+                r2.set_validator( r1.validator() );
+
+                extract_module( &r2, module, path, whitelist, marker, digest );
+
+                r2.commit();
             }
         }
 
@@ -201,6 +742,318 @@ static void install_module( std::string const & package_path, std::string const
     mtime = std::max( mtime, fs_mtime( marker ) );
 }
 
+// parallel installation
+
+struct install_queue
+{
+    std::string package_path;
+
+    // modules grouped by package, as modules of the same
+    // package share a directory and must not be installed
+    // concurrently
+    std::vector< std::vector< std::string > > jobs;
+    std::size_t next;
+
+    bool failed;
+    std::string error;
+
+    std::set< std::string > installed;
+    std::time_t mtime;
+
+    mutex mx;
+};
+
+static void install_worker( void * pv )
+{
+    install_queue * pq = static_cast< install_queue* >( pv );
+
+    for( ;; )
+    {
+        std::vector< std::string > job;
+
+        {
+            scoped_lock lock( pq->mx );
+
+            if( pq->failed || pq->next >= pq->jobs.size() )
+            {
+                // on failure, the other workers complete their current
+                // package, but do not start new ones
+                return;
+            }
+
+            job = pq->jobs[ pq->next++ ];
+        }
+
+        std::set< std::string > installed;
+        std::time_t mtime = 0;
+
+        try
+        {
+            for( std::vector< std::string >::const_iterator i = job.begin(); i != job.end(); ++i )
+            {
+                install_module( pq->package_path, *i, installed, mtime );
+            }
+        }
+        catch( std::exception const & x )
+        {
+            scoped_lock lock( pq->mx );
+
+            if( !pq->failed )
+            {
+                pq->failed = true;
+                pq->error = x.what();
+            }
+
+            return;
+        }
+
+        {
+            scoped_lock lock( pq->mx );
+
+            pq->installed.insert( installed.begin(), installed.end() );
+            pq->mtime = std::max( pq->mtime, mtime );
+        }
+    }
+}
+
+static void install_modules_parallel( std::string const & package_path, std::vector< std::string > const & modules, std::set< std::string > & installed, std::time_t & mtime )
+{
+    install_queue q;
+
+    q.package_path = package_path;
+    q.next = 0;
+    q.failed = false;
+    q.mtime = mtime;
+
+    {
+        std::map< std::string, std::size_t > index;
+
+        for( std::vector< std::string >::const_iterator i = modules.begin(); i != modules.end(); ++i )
+        {
+            std::string package = module_package( *i );
+
+            std::map< std::string, std::size_t >::iterator j = index.find( package );
+
+            if( j == index.end() )
+            {
+                index[ package ] = q.jobs.size();
+                q.jobs.push_back( std::vector< std::string >( 1, *i ) );
+            }
+            else
+            {
+                q.jobs[ j->second ].push_back( *i );
+            }
+        }
+    }
+
+    std::size_t n = std::min< std::size_t >( s_opt_j, q.jobs.size() );
+
+    msg_printf( 1, "installing %u packages using %u workers", static_cast< unsigned >( q.jobs.size() ), static_cast< unsigned >( n ) );
+
+    {
+        std::vector< thread * > workers;
+
+        try
+        {
+            // the current thread acts as the last worker
+
+            for( std::size_t i = 1; i < n; ++i )
+            {
+                workers.push_back( new thread( install_worker, &q ) );
+            }
+        }
+        catch( std::exception const & x )
+        {
+            scoped_lock lock( q.mx );
+
+            if( workers.empty() )
+            {
+                q.failed = true;
+                q.error = x.what();
+            }
+        }
+
+        if( !q.failed )
+        {
+            install_worker( &q );
+        }
+
+        for( std::vector< thread * >::iterator i = workers.begin(); i != workers.end(); ++i )
+        {
+            delete *i; // joins
+        }
+    }
+
+    installed.insert( q.installed.begin(), q.installed.end() );
+    mtime = std::max( mtime, q.mtime );
+
+    if( q.failed )
+    {
+        throw std::runtime_error( q.error );
+    }
+}
+
+// prefetching; while a package is being extracted, a background thread
+// downloads the next ones in the install order into the download cache,
+// from which install_module then takes them
+
+class prefetcher
+{
+private:
+
+    std::string package_path_;
+
+    // in install order
+    std::vector< std::string > packages_;
+
+    enum { pending, fetching, done };
+    std::vector< int > state_;
+
+    // the first package after the one being installed, and how many
+    // packages from there to fetch; none when 0 (-f0)
+    std::size_t next_;
+    std::size_t depth_;
+
+    // nothing is fetched before the first package is being installed,
+    // as that one is downloaded by install_module
+    bool started_;
+
+    bool stop_;
+
+    mutex mx_;
+    condition cn_;
+
+    thread * th_;
+
+private:
+
+    prefetcher( prefetcher const & );
+    prefetcher& operator=( prefetcher const & );
+
+    static void thread_proc( void * pv )
+    {
+        static_cast< prefetcher* >( pv )->run();
+    }
+
+    // the next package to fetch, or -1 when there's none in the window
+    int next() const
+    {
+        if( !started_ ) return -1;
+
+        for( std::size_t i = next_, n = std::min( next_ + depth_, packages_.size() ); i < n; ++i )
+        {
+            if( state_[ i ] == pending )
+            {
+                return static_cast< int >( i );
+            }
+        }
+
+        return -1;
+    }
+
+    void run()
+    {
+        scoped_lock lock( mx_ );
+
+        for( ;; )
+        {
+            int i = next();
+
+            if( stop_ ) return;
+
+            if( i < 0 )
+            {
+                cn_.wait( mx_ );
+                continue;
+            }
+
+            state_[ i ] = fetching;
+
+            std::string tar_name = packages_[ i ] + archive_ext( package_path_ );
+
+            mx_.unlock();
+
+            try
+            {
+                msg_printf( 1, "prefetching '%s'", tar_name.c_str() );
+
+                http_reader r1( package_path_ + tar_name );
+
+                tee_reader r2( &r1, s_cache_path + tar_name );
+                r2.set_validator( r1.validator() );
+
+                r2.commit();
+            }
+            catch( std::exception const & x )
+            {
+                // install_module will retry, and report the error
+                msg_printf( 1, "prefetching '%s' failed: %s", tar_name.c_str(), x.what() );
+            }
+
+            mx_.lock();
+
+            state_[ i ] = done;
+            cn_.notify_all();
+        }
+    }
+
+public:
+
+    // 'packages' must not be installed or cached
+    prefetcher( std::string const & package_path, std::vector< std::string > const & packages, std::size_t depth ): package_path_( package_path ), packages_( packages ), state_( packages.size(), pending ), next_( 0 ), depth_( depth ), started_( false ), stop_( false ), th_( 0 )
+    {
+        if( depth_ > 0 && !packages_.empty() )
+        {
+            th_ = new thread( thread_proc, this );
+        }
+    }
+
+    // waits for the last download in progress to end
+    ~prefetcher()
+    {
+        {
+            scoped_lock lock( mx_ );
+
+            stop_ = true;
+            cn_.notify_all();
+        }
+
+        delete th_;
+    }
+
+    // called before installing 'package'; waits for its prefetch to
+    // complete, or prevents it from starting, and moves the window
+    void claim( std::string const & package )
+    {
+        scoped_lock lock( mx_ );
+
+        if( !started_ )
+        {
+            started_ = true;
+            cn_.notify_all();
+        }
+
+        std::vector< std::string >::const_iterator i = std::find( packages_.begin(), packages_.end(), package );
+
+        if( i == packages_.end() )
+        {
+            return;
+        }
+
+        std::size_t k = i - packages_.begin();
+
+        while( state_[ k ] == fetching )
+        {
+            cn_.wait( mx_ );
+        }
+
+        state_[ k ] = done;
+
+        next_ = std::max( next_, k + 1 );
+        cn_.notify_all();
+    }
+};
+
 static void install_boost_build( std::string const & package_path, std::set< std::string > & installed )
 {
     std::time_t mtime = 0;
@@ -209,7 +1062,7 @@ static void install_boost_build( std::string const & package_path, std::set< std
 
 void cmd_install( char const * argv[] )
 {
-    parse_options( argv, handle_option );
+    parse_options( argv, handle_option, "jfws" );
 
     if( s_opt_a + s_opt_i + s_opt_p > 1 )
     {
@@ -223,6 +1076,11 @@ void cmd_install( char const * argv[] )
 
     std::string package_path = get_package_path();
 
+    if( !s_opt_n )
+    {
+        s_cache_path = cache_get_path( package_path );
+    }
+
     std::map< std::string, std::vector< std::string > > deps;
     std::set< std::string > buildable;
 
@@ -268,9 +1126,9 @@ void cmd_install( char const * argv[] )
         }
     }
 
-    std::set< std::string > installed;
+    // resolve the dependency closure before installing anything
 
-    std::time_t mtime = 0;
+    std::vector< std::string > closure;
 
     {
         std::size_t i = 0;
@@ -285,7 +1143,7 @@ void cmd_install( char const * argv[] )
             }
             else
             {
-                install_module( package_path, module, installed, mtime );
+                closure.push_back( module );
 
                 if( s_opt_d )
                 {
@@ -305,6 +1163,66 @@ void cmd_install( char const * argv[] )
         }
     }
 
+    std::set< std::string > installed;
+
+    std::time_t mtime = 0;
+
+    if( s_opt_j > 1 && !s_opt_n )
+    {
+        install_modules_parallel( package_path, closure, installed, mtime );
+    }
+    else
+    {
+        // the archives that will be downloaded, in install order
+
+        std::vector< std::string > packages;
+        std::vector< std::string > urls;
+
+        if( !s_opt_n && !package_path_is_local( package_path ) )
+        {
+            for( std::vector< std::string >::const_iterator i = closure.begin(); i != closure.end(); ++i )
+            {
+                std::string package = module_package( *i );
+
+                std::string marker = "libs/" + package + "/.installed";
+
+                if( fs_exists( marker ) && !needs_reinstall( "libs/" + package, marker ) )
+                {
+                    continue;
+                }
+
+                std::string tar_name = package + archive_ext( package_path );
+                std::string url = package_path + tar_name;
+
+                bool cached = !s_cache_path.empty() && fs_exists( s_cache_path + tar_name );
+
+                if( !cached && std::find( urls.begin(), urls.end(), url ) == urls.end() )
+                {
+                    urls.push_back( url );
+
+                    // interrupted downloads are resumed by install_module
+                    if( !s_cache_path.empty() && !fs_exists( s_cache_path + tar_name + ".partial" ) )
+                    {
+                        packages.push_back( package );
+                    }
+                }
+            }
+
+            // announce them, so that their requests can be pipelined
+            http_pipeline( urls );
+        }
+
+        // prefetching needs the download cache to hold the archives
+
+        prefetcher pf( package_path, packages, s_opt_f );
+
+        for( std::vector< std::string >::const_iterator i = closure.begin(); i != closure.end(); ++i )
+        {
+            pf.claim( module_package( *i ) );
+            install_module( package_path, *i, installed, mtime );
+        }
+    }
+
     std::set< std::string > installed2;
 
     {
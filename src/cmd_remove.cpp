@@ -13,6 +13,7 @@
 #include "dependencies.hpp"
 #include "message.hpp"
 #include "fs.hpp"
+#include "manifest.hpp"
 #include <algorithm>
 #include <stdexcept>
 #include <cstdio>
@@ -145,7 +146,24 @@ static void remove_package( std::string const & package, int & removed )
 
     std::remove( marker.c_str() );
 
-    fs_remove_all( path, removing, rmerror );
+    // the files listed in the manifest are removed without scanning;
+    // whatever else is left, when there's no manifest or the package
+    // has been modified, is found by fs_remove_all
+
+    std::vector< manifest_entry > manifest;
+
+    if( manifest_read( path + "/.manifest", manifest ) )
+    {
+        std::string fn = path + "/.manifest";
+        std::remove( fn.c_str() );
+
+        manifest_remove( manifest, removing, rmerror );
+    }
+
+    if( fs_exists( path ) )
+    {
+        fs_remove_all( path, removing, rmerror );
+    }
 
     ++removed;
 
@@ -0,0 +1,807 @@
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "cmd_serve.hpp"
+#include "options.hpp"
+#include "message.hpp"
+#include "error.hpp"
+#include <stdexcept>
+#include <cstdlib>
+
+static int s_opt_p = 8080;
+
+static void handle_option( std::string const & opt )
+{
+    if( opt.substr( 0, 2 ) == "-p" )
+    {
+        s_opt_p = std::atoi( opt.c_str() + 2 );
+
+        if( s_opt_p <= 0 || s_opt_p >= 65536 )
+        {
+            throw std::runtime_error( "invalid port number: '" + opt.substr( 2 ) + "'" );
+        }
+    }
+    else if( opt == "-v" )
+    {
+        increase_message_level();
+    }
+    else if( opt == "-q" )
+    {
+        decrease_message_level();
+    }
+    else
+    {
+        throw std::runtime_error( "invalid serve option: '" + opt + "'" );
+    }
+}
+
+#if defined( __linux__ )
+
+#include <map>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+
+// A single-threaded HTTP/1.1 server for a release directory. Connections
+// are non-blocking and multiplexed with epoll; file bodies are sent with
+// sendfile, so their contents are never copied into this process.
+
+static std::size_t const max_request_size = 16384;
+static int const idle_timeout = 60; // seconds
+
+struct serve_connection
+{
+    int fd;
+
+    std::string input;
+
+    std::string output; // response headers, or a short body
+    std::size_t output_sent;
+
+    int file;
+    off_t file_offset;
+    off_t file_remaining;
+
+    bool keep_alive;
+    bool responded;
+
+    std::time_t last_active;
+
+    serve_connection( int fd_ ): fd( fd_ ), output_sent( 0 ), file( -1 ), file_offset( 0 ), file_remaining( 0 ), keep_alive( false ), responded( false ), last_active( std::time( 0 ) )
+    {
+    }
+
+    bool busy() const
+    {
+        return output_sent < output.size() || file_remaining > 0;
+    }
+};
+
+static std::string http_date( std::time_t t )
+{
+    char buffer[ 64 ];
+
+    tm g;
+    gmtime_r( &t, &g );
+
+    std::strftime( buffer, sizeof( buffer ), "%a, %d %b %Y %H:%M:%S GMT", &g );
+
+    return buffer;
+}
+
+static int hex_digit( char ch )
+{
+    if( ch >= '0' && ch <= '9' ) return ch - '0';
+    if( ch >= 'a' && ch <= 'f' ) return ch - 'a' + 10;
+    if( ch >= 'A' && ch <= 'F' ) return ch - 'A' + 10;
+
+    return -1;
+}
+
+// parses a nonempty decimal number
+static bool parse_number( std::string const & s, long long & v )
+{
+    if( s.empty() || s.size() > 18 || s.find_first_not_of( "0123456789" ) != std::string::npos )
+    {
+        return false;
+    }
+
+    v = std::strtoll( s.c_str(), 0, 10 );
+    return true;
+}
+
+// parses a Range header for a single byte range, first-[last] or -suffix,
+// of a file of 'size' bytes; returns false when there is none or it's
+// invalid, so that it's ignored. A valid range that isn't satisfiable
+// is returned with 'first' > 'last'
+static bool parse_range( std::string const & range, long long size, long long & first, long long & last )
+{
+    if( range.substr( 0, 6 ) != "bytes=" || range.find( ',' ) != std::string::npos )
+    {
+        return false;
+    }
+
+    std::string spec = range.substr( 6 );
+    std::size_t i = spec.find( '-' );
+
+    if( i == std::string::npos )
+    {
+        return false;
+    }
+
+    std::string a = spec.substr( 0, i ), b = spec.substr( i + 1 );
+
+    long long m = 0, n = 0;
+
+    if( a.empty() )
+    {
+        if( !parse_number( b, n ) )
+        {
+            return false;
+        }
+
+        // the last n bytes; none is never satisfiable
+        first = n == 0? size: n < size? size - n: 0;
+        last = size - 1;
+
+        return true;
+    }
+
+    if( !parse_number( a, m ) || ( !b.empty() && ( !parse_number( b, n ) || n < m ) ) )
+    {
+        return false;
+    }
+
+    first = m;
+    last = b.empty()? size - 1: std::min( n, size - 1 );
+
+    return true;
+}
+
+// maps the request target to a path under 'root'; returns false if it
+// doesn't name a file there
+static bool map_path( std::string const & root, std::string const & target, std::string & path )
+{
+    std::string t = target.substr( 0, target.find( '?' ) );
+
+    if( t.empty() || t[ 0 ] != '/' )
+    {
+        return false;
+    }
+
+    std::string r;
+
+    for( std::size_t i = 0; i < t.size(); ++i )
+    {
+        char ch = t[ i ];
+
+        if( ch == '%' && i + 2 < t.size() && hex_digit( t[ i + 1 ] ) >= 0 && hex_digit( t[ i + 2 ] ) >= 0 )
+        {
+            ch = static_cast< char >( hex_digit( t[ i + 1 ] ) * 16 + hex_digit( t[ i + 2 ] ) );
+            i += 2;
+        }
+
+        if( ch == 0 || ch == '\\' )
+        {
+            return false;
+        }
+
+        r += ch;
+    }
+
+    if( ( r + '/' ).find( "/../" ) != std::string::npos )
+    {
+        return false;
+    }
+
+    path = root + r;
+    return true;
+}
+
+class http_server
+{
+private:
+
+    std::string root_;
+
+    int ep_;
+    int listener_;
+
+    std::map< int, serve_connection * > connections_;
+
+private:
+
+    void update_events( serve_connection * pc )
+    {
+        epoll_event ev = {};
+
+        ev.events = pc->busy()? EPOLLOUT: EPOLLIN;
+        ev.data.fd = pc->fd;
+
+        epoll_ctl( ep_, EPOLL_CTL_MOD, pc->fd, &ev );
+    }
+
+    void close_connection( serve_connection * pc )
+    {
+        epoll_ctl( ep_, EPOLL_CTL_DEL, pc->fd, 0 );
+
+        ::close( pc->fd );
+
+        if( pc->file >= 0 )
+        {
+            ::close( pc->file );
+        }
+
+        connections_.erase( pc->fd );
+        delete pc;
+    }
+
+    void accept_connections()
+    {
+        for( ;; )
+        {
+            int fd = ::accept4( listener_, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC );
+
+            if( fd < 0 )
+            {
+                if( errno == EINTR ) continue;
+                return; // EAGAIN, or out of descriptors
+            }
+
+            int one = 1;
+            ::setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ) );
+
+            serve_connection * pc = new serve_connection( fd );
+
+            epoll_event ev;
+            std::memset( &ev, 0, sizeof( ev ) );
+
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+
+            if( epoll_ctl( ep_, EPOLL_CTL_ADD, fd, &ev ) != 0 )
+            {
+                ::close( fd );
+                delete pc;
+
+                continue;
+            }
+
+            connections_[ fd ] = pc;
+        }
+    }
+
+    void respond( serve_connection * pc, int status, char const * reason, std::string const & headers, std::string const & body = std::string() )
+    {
+        char buffer[ 64 ];
+        std::sprintf( buffer, "HTTP/1.1 %d %s\r\n", status, reason );
+
+        pc->output = buffer;
+        pc->output += headers;
+
+        if( !body.empty() || headers.find( "Content-Length:" ) == std::string::npos )
+        {
+            std::sprintf( buffer, "Content-Length: %u\r\n", static_cast< unsigned >( body.size() ) );
+            pc->output += buffer;
+        }
+
+        pc->output += pc->keep_alive? "": "Connection: close\r\n";
+        pc->output += "\r\n";
+        pc->output += body;
+
+        pc->output_sent = 0;
+    }
+
+    void error_response( serve_connection * pc, int status, char const * reason )
+    {
+        respond( pc, status, reason, "Content-Type: text/plain\r\n", std::string( reason ) + "\n" );
+    }
+
+    // handles the request at the start of pc->input, if complete;
+    // returns false when more input is needed
+    bool handle_request( serve_connection * pc )
+    {
+        std::size_t end = pc->input.find( "\r\n\r\n" );
+
+        if( end == std::string::npos )
+        {
+            if( pc->input.size() > max_request_size )
+            {
+                pc->keep_alive = false;
+                error_response( pc, 400, "Bad Request" );
+
+                return true;
+            }
+
+            return false;
+        }
+
+        std::string request = pc->input.substr( 0, end + 2 );
+        pc->input.erase( 0, end + 4 );
+
+        std::istringstream is( request );
+
+        std::string method, target, version;
+
+        {
+            std::string line;
+            std::getline( is, line );
+
+            std::istringstream is2( line );
+            is2 >> method >> target >> version;
+        }
+
+        std::map< std::string, std::string > headers;
+
+        for( std::string line; std::getline( is, line ); )
+        {
+            if( !line.empty() && *line.rbegin() == '\r' ) line.resize( line.size() - 1 );
+
+            std::size_t i = line.find( ':' );
+
+            if( i == std::string::npos ) continue;
+
+            std::string name = line.substr( 0, i );
+            std::transform( name.begin(), name.end(), name.begin(), ::tolower );
+
+            std::size_t j = line.find_first_not_of( " \t", i + 1 );
+            headers[ name ] = j == std::string::npos? std::string(): line.substr( j );
+        }
+
+        std::string connection = headers[ "connection" ];
+        std::transform( connection.begin(), connection.end(), connection.begin(), ::tolower );
+
+        if( version == "HTTP/1.1" )
+        {
+            pc->keep_alive = connection != "close";
+        }
+        else if( version == "HTTP/1.0" )
+        {
+            pc->keep_alive = connection == "keep-alive";
+        }
+        else
+        {
+            pc->keep_alive = false;
+            error_response( pc, 400, "Bad Request" );
+
+            return true;
+        }
+
+        bool head = method == "HEAD";
+
+        if( method != "GET" && !head )
+        {
+            error_response( pc, 501, "Not Implemented" );
+            return true;
+        }
+
+        std::string path;
+
+        struct stat st;
+
+        if( !map_path( root_, target, path ) || ::stat( path.c_str(), &st ) != 0 || !S_ISREG( st.st_mode ) )
+        {
+            msg_printf( 1, "%s %s: not found", method.c_str(), target.c_str() );
+
+            error_response( pc, 404, "Not Found" );
+            return true;
+        }
+
+        char buffer[ 256 ];
+
+        std::sprintf( buffer, "\"%llx-%llx\"", static_cast< unsigned long long >( st.st_size ), static_cast< unsigned long long >( st.st_mtime ) );
+        std::string etag = buffer;
+
+        std::string last_modified = http_date( st.st_mtime );
+
+        std::string common = "ETag: " + etag + "\r\nLast-Modified: " + last_modified + "\r\nAccept-Ranges: bytes\r\n";
+
+        // conditional requests, as sent by bpm for the metadata
+
+        if( headers.count( "if-none-match" )? headers[ "if-none-match" ] == etag: headers[ "if-modified-since" ] == last_modified )
+        {
+            msg_printf( 1, "%s %s: not modified", method.c_str(), target.c_str() );
+
+            respond( pc, 304, "Not Modified", common + "Content-Length: 0\r\n" );
+            return true;
+        }
+
+        // a single byte range, ignored when If-Range names another
+        // version of the file
+
+        off_t size = st.st_size;
+        off_t first = 0, last = size - 1;
+
+        bool partial = false;
+
+        std::string if_range = headers[ "if-range" ];
+        long long f = 0, l = 0;
+
+        if( ( if_range.empty() || if_range == etag || if_range == last_modified ) && parse_range( headers[ "range" ], size, f, l ) )
+        {
+            if( f > l )
+            {
+                msg_printf( 1, "%s %s: range not satisfiable", method.c_str(), target.c_str() );
+
+                std::sprintf( buffer, "Content-Range: bytes */%lld\r\n", static_cast< long long >( size ) );
+                respond( pc, 416, "Range Not Satisfiable", common + buffer + "Content-Length: 0\r\n" );
+
+                return true;
+            }
+
+            first = f;
+            last = l;
+
+            partial = true;
+        }
+
+        int file = head? -1: ::open( path.c_str(), O_RDONLY | O_CLOEXEC );
+
+        if( !head && file < 0 )
+        {
+            error_response( pc, 404, "Not Found" );
+            return true;
+        }
+
+        off_t length = last - first + 1;
+
+        std::sprintf( buffer, "Content-Length: %lld\r\n", static_cast< long long >( length ) );
+        std::string h = common + buffer + "Content-Type: application/octet-stream\r\n";
+
+        if( partial )
+        {
+            std::sprintf( buffer, "Content-Range: bytes %lld-%lld/%lld\r\n", static_cast< long long >( first ), static_cast< long long >( last ), static_cast< long long >( size ) );
+            respond( pc, 206, "Partial Content", h + buffer );
+        }
+        else
+        {
+            respond( pc, 200, "OK", h );
+        }
+
+        msg_printf( 1, "%s %s: %lld bytes", method.c_str(), target.c_str(), static_cast< long long >( head? 0: length ) );
+
+        if( !head )
+        {
+            pc->file = file;
+            pc->file_offset = first;
+            pc->file_remaining = length;
+        }
+
+        return true;
+    }
+
+    // sends pending output; returns false on error
+    bool send_output( serve_connection * pc )
+    {
+        while( pc->output_sent < pc->output.size() )
+        {
+            ssize_t r = ::send( pc->fd, pc->output.data() + pc->output_sent, pc->output.size() - pc->output_sent, MSG_NOSIGNAL | ( pc->file_remaining > 0? MSG_MORE: 0 ) );
+
+            if( r < 0 )
+            {
+                return errno == EAGAIN || errno == EINTR;
+            }
+
+            pc->output_sent += r;
+        }
+
+        while( pc->file_remaining > 0 )
+        {
+            std::size_t n = static_cast< std::size_t >( std::min< off_t >( pc->file_remaining, 1 << 30 ) );
+
+            ssize_t r = ::sendfile( pc->fd, pc->file, &pc->file_offset, n );
+
+            if( r < 0 )
+            {
+                return errno == EAGAIN || errno == EINTR;
+            }
+
+            if( r == 0 )
+            {
+                // the file has been truncated
+                return false;
+            }
+
+            pc->file_remaining -= r;
+        }
+
+        if( pc->file >= 0 )
+        {
+            ::close( pc->file );
+            pc->file = -1;
+        }
+
+        return true;
+    }
+
+    void on_event( serve_connection * pc, unsigned events )
+    {
+        pc->last_active = std::time( 0 );
+
+        if( events & ( EPOLLERR | EPOLLHUP ) )
+        {
+            close_connection( pc );
+            return;
+        }
+
+        if( ( events & EPOLLIN ) && !pc->busy() )
+        {
+            char buffer[ 4096 ];
+
+            ssize_t r = ::recv( pc->fd, buffer, sizeof( buffer ), 0 );
+
+            if( r == 0 || ( r < 0 && errno != EAGAIN && errno != EINTR ) )
+            {
+                close_connection( pc );
+                return;
+            }
+
+            if( r > 0 )
+            {
+                pc->input.append( buffer, r );
+            }
+        }
+
+        // send responses to the complete requests received, in order
+
+        for( ;; )
+        {
+            if( !send_output( pc ) )
+            {
+                close_connection( pc );
+                return;
+            }
+
+            if( pc->busy() )
+            {
+                break;
+            }
+
+            if( !pc->keep_alive && pc->responded )
+            {
+                close_connection( pc );
+                return;
+            }
+
+            if( !handle_request( pc ) )
+            {
+                break;
+            }
+
+            pc->responded = true; // close after the response, unless keep_alive
+        }
+
+        update_events( pc );
+    }
+
+    void close_idle()
+    {
+        std::time_t now = std::time( 0 );
+
+        std::vector< serve_connection * > v;
+
+        for( std::map< int, serve_connection * >::iterator i = connections_.begin(); i != connections_.end(); ++i )
+        {
+            if( now - i->second->last_active > idle_timeout )
+            {
+                v.push_back( i->second );
+            }
+        }
+
+        for( std::size_t i = 0; i < v.size(); ++i )
+        {
+            close_connection( v[ i ] );
+        }
+    }
+
+public:
+
+    http_server( std::string const & root, int port ): root_( root ), ep_( -1 ), listener_( -1 )
+    {
+        char buffer[ 32 ];
+        std::sprintf( buffer, "port %d", port );
+
+        std::string name = buffer;
+
+        // IPv6 and IPv4 on one socket where possible
+
+        sockaddr_in6 a6;
+        std::memset( &a6, 0, sizeof( a6 ) );
+
+        a6.sin6_family = AF_INET6;
+        a6.sin6_addr = in6addr_any;
+        a6.sin6_port = htons( static_cast< unsigned short >( port ) );
+
+        sockaddr_in a4;
+        std::memset( &a4, 0, sizeof( a4 ) );
+
+        a4.sin_family = AF_INET;
+        a4.sin_addr.s_addr = htonl( INADDR_ANY );
+        a4.sin_port = htons( static_cast< unsigned short >( port ) );
+
+        listener_ = ::socket( AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+
+        sockaddr const * sa = reinterpret_cast< sockaddr const* >( &a6 );
+        socklen_t sn = sizeof( a6 );
+
+        if( listener_ < 0 )
+        {
+            listener_ = ::socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+
+            sa = reinterpret_cast< sockaddr const* >( &a4 );
+            sn = sizeof( a4 );
+        }
+        else
+        {
+            int zero = 0;
+            ::setsockopt( listener_, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof( zero ) );
+        }
+
+        if( listener_ < 0 )
+        {
+            throw_errno_error( name, "socket create error", errno );
+        }
+
+        int one = 1;
+        ::setsockopt( listener_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof( one ) );
+
+        if( ::bind( listener_, sa, sn ) != 0 )
+        {
+            int r = errno;
+            ::close( listener_ );
+
+            throw_errno_error( name, "bind error", r );
+        }
+
+        if( ::listen( listener_, SOMAXCONN ) != 0 )
+        {
+            int r = errno;
+            ::close( listener_ );
+
+            throw_errno_error( name, "listen error", r );
+        }
+
+        ep_ = ::epoll_create1( EPOLL_CLOEXEC );
+
+        if( ep_ < 0 )
+        {
+            int r = errno;
+            ::close( listener_ );
+
+            throw_errno_error( name, "epoll create error", r );
+        }
+
+        epoll_event ev;
+        std::memset( &ev, 0, sizeof( ev ) );
+
+        ev.events = EPOLLIN;
+        ev.data.fd = listener_;
+
+        epoll_ctl( ep_, EPOLL_CTL_ADD, listener_, &ev );
+    }
+
+    ~http_server()
+    {
+        while( !connections_.empty() )
+        {
+            close_connection( connections_.begin()->second );
+        }
+
+        ::close( ep_ );
+        ::close( listener_ );
+    }
+
+    void run()
+    {
+        epoll_event events[ 256 ];
+
+        std::time_t last_sweep = std::time( 0 );
+
+        for( ;; )
+        {
+            int n = ::epoll_wait( ep_, events, 256, 5000 );
+
+            if( n < 0 && errno != EINTR )
+            {
+                throw_errno_error( "epoll", "wait error", errno );
+            }
+
+            for( int i = 0; i < n; ++i )
+            {
+                int fd = events[ i ].data.fd;
+
+                if( fd == listener_ )
+                {
+                    accept_connections();
+                    continue;
+                }
+
+                std::map< int, serve_connection * >::iterator j = connections_.find( fd );
+
+                if( j != connections_.end() )
+                {
+                    on_event( j->second, events[ i ].events );
+                }
+            }
+
+            if( std::time( 0 ) - last_sweep >= 5 )
+            {
+                close_idle();
+                last_sweep = std::time( 0 );
+            }
+        }
+    }
+};
+
+static void serve( std::string const & dir, int port )
+{
+    struct stat st;
+
+    if( ::stat( dir.c_str(), &st ) != 0 || !S_ISDIR( st.st_mode ) )
+    {
+        throw_error( dir, "not a directory" );
+    }
+
+    std::string root = dir;
+
+    while( root.size() > 1 && *root.rbegin() == '/' )
+    {
+        root.resize( root.size() - 1 );
+    }
+
+    ::signal( SIGPIPE, SIG_IGN );
+
+    http_server server( root, port );
+
+    msg_printf( 0, "serving '%s' on port %d", dir.c_str(), port );
+
+    server.run();
+}
+
+#else
+
+static void serve( std::string const & /*dir*/, int /*port*/ )
+{
+    throw std::runtime_error( "the serve command is not supported on this platform" );
+}
+
+#endif // defined( __linux__ )
+
+void cmd_serve( char const * argv[] )
+{
+    parse_options( argv, handle_option, "p" );
+
+    if( *argv == 0 )
+    {
+        throw std::runtime_error( "no release directory given" );
+    }
+
+    std::string dir = *argv++;
+
+    if( *argv != 0 )
+    {
+        throw std::runtime_error( std::string( "unexpected argument: '" ) + *argv + "'" );
+    }
+
+    serve( dir, s_opt_p );
+}
@@ -0,0 +1,153 @@
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "cmd_verify.hpp"
+#include "options.hpp"
+#include "message.hpp"
+#include "manifest.hpp"
+#include "error.hpp"
+#include "fs.hpp"
+#include <stdexcept>
+#include <cstdio>
+#include <errno.h>
+
+static void handle_option( std::string const & opt )
+{
+    if( opt == "-v" )
+    {
+        increase_message_level();
+    }
+    else if( opt == "-q" )
+    {
+        decrease_message_level();
+    }
+    else
+    {
+        throw std::runtime_error( "invalid verify option: '" + opt + "'" );
+    }
+}
+
+static std::string package_directory( std::string const & package )
+{
+    return package == "build"? "tools/build": "libs/" + package;
+}
+
+// compares the files of the package with its manifest; returns false
+// when they differ
+
+static bool verify_package( std::string const & package )
+{
+    std::string path = package_directory( package );
+
+    if( !fs_exists( path + "/.installed" ) )
+    {
+        msg_printf( 0, "package '%s' is not installed", package.c_str() );
+        return false;
+    }
+
+    std::vector< manifest_entry > manifest;
+
+    if( !manifest_read( path + "/.manifest", manifest ) )
+    {
+        msg_printf( -1, "package '%s' has no manifest, not verifying", package.c_str() );
+        return true;
+    }
+
+    bool r = true;
+
+    for( std::vector< manifest_entry >::const_iterator i = manifest.begin(); i != manifest.end(); ++i )
+    {
+        char const * fn = i->path.c_str();
+
+        msg_printf( 2, "verifying '%s'", fn );
+
+        if( i->type == 'd' )
+        {
+            if( !fs_is_dir( i->path ) )
+            {
+                msg_printf( 0, "'%s': directory is missing", fn );
+                r = false;
+            }
+        }
+        else
+        {
+            long long size = fs_size( i->path );
+
+            if( size < 0 )
+            {
+                msg_printf( 0, "'%s': file is missing", fn );
+                r = false;
+            }
+            else if( size != i->size || fs_mtime( i->path ) != i->mtime )
+            {
+                msg_printf( 0, "'%s': file has been modified", fn );
+                r = false;
+            }
+        }
+    }
+
+    msg_printf( 1, "package '%s' %s", package.c_str(), r? "verified": "differs from its manifest" );
+
+    return r;
+}
+
+void cmd_verify( char const * argv[] )
+{
+    parse_options( argv, handle_option );
+
+    std::vector< std::string > packages;
+
+    while( *argv )
+    {
+        packages.push_back( *argv );
+        ++argv;
+    }
+
+    if( packages.empty() )
+    {
+        // all installed packages
+
+        std::vector< std::string > entries;
+
+        if( fs_exists( "libs" ) && fs_readdir( "libs", entries ) != 0 )
+        {
+            throw_errno_error( "libs", "read error", errno );
+        }
+
+        for( std::vector< std::string >::const_iterator i = entries.begin(); i != entries.end(); ++i )
+        {
+            if( fs_exists( "libs/" + *i + "/.installed" ) )
+            {
+                packages.push_back( *i );
+            }
+        }
+
+        if( fs_exists( "tools/build/.installed" ) )
+        {
+            packages.push_back( "build" );
+        }
+    }
+
+    int failed = 0;
+
+    for( std::vector< std::string >::const_iterator i = packages.begin(); i != packages.end(); ++i )
+    {
+        if( !verify_package( *i ) )
+        {
+            ++failed;
+        }
+    }
+
+    if( failed != 0 )
+    {
+        char buffer[ 64 ];
+        std::sprintf( buffer, "%d package(s) failed verification", failed );
+
+        throw std::runtime_error( buffer );
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef CMD_VERIFY_HPP_INCLUDED
+#define CMD_VERIFY_HPP_INCLUDED
+
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+void cmd_verify( char const * argv[] );
+
+#endif // #ifndef CMD_VERIFY_HPP_INCLUDED
@@ -0,0 +1,65 @@
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "crc.hpp"
+
+// reflected, table-driven, one byte at a time
+
+struct crc_tables
+{
+    unsigned t32[ 256 ];
+    unsigned long long t64[ 256 ];
+
+    crc_tables()
+    {
+        for( unsigned i = 0; i < 256; ++i )
+        {
+            unsigned c = i;
+            unsigned long long c2 = i;
+
+            for( int j = 0; j < 8; ++j )
+            {
+                c = ( c & 1 )? ( c >> 1 ) ^ 0xEDB88320u: c >> 1;
+                c2 = ( c2 & 1 )? ( c2 >> 1 ) ^ 0xC96C5795D7870F42ULL: c2 >> 1;
+            }
+
+            t32[ i ] = c;
+            t64[ i ] = c2;
+        }
+    }
+};
+
+static crc_tables const s_tables;
+
+unsigned crc32_update( unsigned crc, void const * p, std::size_t n )
+{
+    unsigned char const * q = static_cast< unsigned char const* >( p );
+
+    crc = ~crc & 0xFFFFFFFFu;
+
+    for( std::size_t i = 0; i < n; ++i )
+    {
+        crc = s_tables.t32[ ( crc ^ q[ i ] ) & 0xFF ] ^ ( crc >> 8 );
+    }
+
+    return ~crc & 0xFFFFFFFFu;
+}
+
+unsigned long long crc64_update( unsigned long long crc, void const * p, std::size_t n )
+{
+    unsigned char const * q = static_cast< unsigned char const* >( p );
+
+    crc = ~crc;
+
+    for( std::size_t i = 0; i < n; ++i )
+    {
+        crc = s_tables.t64[ ( crc ^ q[ i ] ) & 0xFF ] ^ ( crc >> 8 );
+    }
+
+    return ~crc;
+}
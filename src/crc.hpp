@@ -0,0 +1,20 @@
+#ifndef CRC_HPP_INCLUDED
+#define CRC_HPP_INCLUDED
+
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <cstddef>
+
+// the CRC-32 and CRC-64 checks of the xz format; start with 0, and
+// pass the previous result to continue over more data
+
+unsigned crc32_update( unsigned crc, void const * p, std::size_t n );
+unsigned long long crc64_update( unsigned long long crc, void const * p, std::size_t n );
+
+#endif // #ifndef CRC_HPP_INCLUDED
@@ -10,10 +10,20 @@
 #include "package_path.hpp"
 #include "lzma_reader.hpp"
 #include "http_reader.hpp"
+#include "mmap_reader.hpp"
+#include "cache.hpp"
+#include "config.hpp"
+#include "message.hpp"
 #include "error.hpp"
 #include "string.hpp"
+#include "fs.hpp"
 #include <stdexcept>
 #include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <ctime>
 
 static void parse_module_description( std::string const & name, std::string const & line, std::map< std::string, std::vector< std::string > > & deps )
 {
@@ -38,10 +48,9 @@ static void parse_module_description( std::string const & name, std::string cons
     }
 }
 
-static std::string read_text_file( std::string const & url )
+static std::string read_data( basic_reader * pr )
 {
-    http_reader r1( url );
-    lzma_reader r2( &r1 );
+    lzma_reader r2( pr );
 
     std::string data;
 
@@ -61,6 +70,271 @@ static std::string read_text_file( std::string const & url )
     return data;
 }
 
+// metadata cache
+
+static std::string s_cache_path;
+
+static std::time_t metadata_ttl()
+{
+    std::string ttl = config_get_option( "metadata_ttl" );
+
+    if( ttl.empty() )
+    {
+        return 3600;
+    }
+
+    return std::atoi( ttl.c_str() );
+}
+
+static bool read_file( std::string const & fn, std::string & data )
+{
+    std::ifstream is( fn.c_str(), std::ios_base::binary );
+
+    if( !is )
+    {
+        return false;
+    }
+
+    std::ostringstream os;
+    os << is.rdbuf();
+
+    data = os.str();
+    return true;
+}
+
+static void write_file( std::string const & fn, std::string const & data )
+{
+    std::string temp = cache_temp_name( fn );
+
+    {
+        std::ofstream os( temp.c_str(), std::ios_base::binary );
+
+        os << data;
+
+        if( !os )
+        {
+            msg_printf( 1, "'%s': write error", temp.c_str() );
+            return;
+        }
+    }
+
+    if( fs_rename( temp, fn ) != 0 )
+    {
+        msg_printf( 1, "'%s': rename error", temp.c_str() );
+        std::remove( temp.c_str() );
+    }
+}
+
+// the .meta file next to a cached file holds the validators of the response
+// it came from, and the time at which it has last been checked against the server
+
+static void read_meta( std::string const & fn, std::string & etag, std::string & last_modified, std::time_t & checked )
+{
+    std::ifstream is( fn.c_str() );
+
+    std::string line;
+
+    while( std::getline( is, line ) )
+    {
+        remove_trailing( line, '\r' );
+
+        std::size_t i = line.find( '=' );
+
+        if( i == std::string::npos ) continue;
+
+        std::string key = line.substr( 0, i );
+        std::string value = line.substr( i + 1 );
+
+        if( key == "etag" )
+        {
+            etag = value;
+        }
+        else if( key == "last-modified" )
+        {
+            last_modified = value;
+        }
+        else if( key == "checked" )
+        {
+            checked = static_cast< std::time_t >( std::strtoll( value.c_str(), 0, 10 ) );
+        }
+    }
+}
+
+static void write_meta( std::string const & fn, std::string const & etag, std::string const & last_modified, std::time_t checked )
+{
+    char buffer[ 32 ];
+    std::sprintf( buffer, "%lld", static_cast< long long >( checked ) );
+
+    write_file( fn, "etag=" + etag + "\nlast-modified=" + last_modified + "\nchecked=" + buffer + "\n" );
+}
+
+// with 'found', a file the server doesn't have (404) sets *found to false
+// instead of throwing; this is cached like the file itself would be, in
+// a .missing file that holds the time of the check, so that it's neither
+// requested again before metadata_ttl, nor needed when offline
+
+static std::string read_text_file( std::string const & url, bool * found = 0 )
+{
+    if( found )
+    {
+        *found = true;
+    }
+
+    std::string name = url.substr( url.rfind( '/' ) + 1 ); // dependencies.txt.lzma
+
+    if( package_path_is_local( url ) )
+    {
+        mmap_reader r1( package_file_name( url ) );
+        return read_data( &r1 );
+    }
+
+    if( s_cache_path.empty() )
+    {
+        try
+        {
+            http_reader r1( url );
+            return read_data( &r1 );
+        }
+        catch( std::exception const & x )
+        {
+            if( !found || !http_is_not_found( x ) )
+            {
+                throw;
+            }
+
+            msg_printf( 1, "%s", x.what() );
+
+            *found = false;
+            return std::string();
+        }
+    }
+
+    std::string fn = s_cache_path + name.substr( 0, name.size() - 5 ); // dependencies.txt
+    std::string meta = fn + ".meta";
+    std::string missing = fn + ".missing";
+
+    std::string data;
+
+    std::string etag, last_modified;
+    std::time_t checked = 0;
+
+    if( found && fs_exists( missing ) )
+    {
+        read_meta( missing, etag, last_modified, checked );
+
+        std::time_t now = std::time( 0 );
+
+        if( now >= checked && now - checked < metadata_ttl() )
+        {
+            msg_printf( 2, "'%s' does not exist, according to cached '%s'", url.c_str(), missing.c_str() );
+
+            *found = false;
+            return data;
+        }
+
+        checked = 0;
+    }
+
+    if( fs_exists( fn ) )
+    {
+        read_meta( meta, etag, last_modified, checked );
+
+        std::time_t now = std::time( 0 );
+
+        if( now >= checked && now - checked < metadata_ttl() && read_file( fn, data ) )
+        {
+            msg_printf( 2, "using cached '%s'", fn.c_str() );
+            return data;
+        }
+    }
+
+    try
+    {
+        std::string headers;
+
+        if( !etag.empty() )
+        {
+            headers += "If-None-Match: " + etag + "\r\n";
+        }
+
+        if( !last_modified.empty() )
+        {
+            headers += "If-Modified-Since: " + last_modified + "\r\n";
+        }
+
+        http_reader r1( url, headers );
+
+        if( r1.status() == 304 && read_file( fn, data ) )
+        {
+            msg_printf( 2, "'%s' has not been modified, using cached '%s'", url.c_str(), fn.c_str() );
+            write_meta( meta, etag, last_modified, std::time( 0 ) );
+
+            return data;
+        }
+
+        if( r1.status() == 304 )
+        {
+            // cached file has gone away; fetch unconditionally
+            http_reader r2( url );
+            data = read_data( &r2 );
+
+            etag = r2.header( "etag" );
+            last_modified = r2.header( "last-modified" );
+        }
+        else
+        {
+            data = read_data( &r1 );
+
+            etag = r1.header( "etag" );
+            last_modified = r1.header( "last-modified" );
+        }
+    }
+    catch( std::exception const & x )
+    {
+        if( found && http_is_not_found( x ) )
+        {
+            msg_printf( 1, "%s", x.what() );
+
+            std::remove( fn.c_str() );
+            std::remove( meta.c_str() );
+
+            write_meta( missing, "", "", std::time( 0 ) );
+
+            *found = false;
+            return data;
+        }
+
+        if( read_file( fn, data ) )
+        {
+            msg_printf( -1, "%s", x.what() );
+            msg_printf( -1, "using cached '%s'", fn.c_str() );
+
+            return data;
+        }
+
+        if( found && fs_exists( missing ) )
+        {
+            msg_printf( -1, "%s", x.what() );
+            msg_printf( -1, "'%s' did not exist when last checked, assuming it still doesn't", url.c_str() );
+
+            *found = false;
+            return data;
+        }
+
+        throw;
+    }
+
+    write_file( fn, data );
+    write_meta( meta, etag, last_modified, std::time( 0 ) );
+
+    if( found && fs_exists( missing ) )
+    {
+        std::remove( missing.c_str() );
+    }
+
+    return data;
+}
+
 static void retrieve_dependencies( std::string const & package_path, std::map< std::string, std::vector< std::string > > & deps )
 {
     std::string url = package_path + "dependencies.txt.lzma";
@@ -99,6 +373,103 @@ void retrieve_dependencies( std::map< std::string, std::vector< std::string > >
 
     std::string package_path = get_package_path();
 
+    s_cache_path = cache_get_path( package_path );
+
+    if( !package_path_is_local( package_path ) && ( s_cache_path.empty() || !fs_exists( s_cache_path + "dependencies.txt" ) ) )
+    {
+        std::vector< std::string > urls;
+
+        urls.push_back( package_path + "dependencies.txt.lzma" );
+        urls.push_back( package_path + "buildable.txt.lzma" );
+
+        http_pipeline( urls );
+    }
+
     retrieve_dependencies( package_path, deps );
     retrieve_buildable( package_path, buildable );
+
+    if( !s_cache_path.empty() )
+    {
+        // the version of dependencies.txt identifies that of the release,
+        // and so, of the archives in the cache
+
+        std::string etag, last_modified;
+        std::time_t checked = 0;
+
+        read_meta( s_cache_path + "dependencies.txt.meta", etag, last_modified, checked );
+
+        cache_set_release( s_cache_path, etag.empty()? last_modified: etag );
+    }
+}
+
+static bool is_sha256_digest( std::string const & s )
+{
+    return s.size() == 64 && s.find_first_not_of( "0123456789abcdef" ) == std::string::npos;
+}
+
+void retrieve_digests( std::map< std::string, std::string > & digests )
+{
+    digests.clear();
+
+    std::string url = get_package_path() + "sha256.txt.lzma";
+
+    std::string data;
+
+    // only a missing file means that the release has no digests; any
+    // other error would otherwise silently turn verification off
+
+    if( package_path_is_local( url ) && !fs_exists( package_file_name( url ) ) )
+    {
+        msg_printf( 1, "'%s' does not exist", package_file_name( url ).c_str() );
+        msg_printf( 1, "the release has no SHA-256 digests, archives will not be verified" );
+
+        return;
+    }
+
+    bool found = true;
+
+    data = read_text_file( url, &found );
+
+    if( !found )
+    {
+        msg_printf( 1, "the release has no SHA-256 digests, archives will not be verified" );
+        return;
+    }
+
+    std::istringstream is( data );
+
+    std::string line;
+
+    while( std::getline( is, line ) )
+    {
+        remove_trailing( line, '\r' );
+
+        if( line.empty() )
+        {
+            continue;
+        }
+
+        // <digest>, a space, then a space or '*' (binary mode), then the name
+
+        std::string digest = line.substr( 0, 64 );
+
+        for( std::size_t i = 0; i < digest.size(); ++i )
+        {
+            digest[ i ] = static_cast< char >( std::tolower( static_cast< unsigned char >( digest[ i ] ) ) );
+        }
+
+        if( !is_sha256_digest( digest ) || line.size() < 67 || line[ 64 ] != ' ' || ( line[ 65 ] != ' ' && line[ 65 ] != '*' ) )
+        {
+            throw_error( url, "invalid line: '" + line + "'" );
+        }
+
+        std::string name = line.substr( 66 );
+
+        // sha256sum may have been run on paths
+        name = name.substr( name.find_last_of( "/\\" ) + 1 );
+
+        digests[ name ] = digest;
+    }
+
+    msg_printf( 2, "read %u SHA-256 digests", static_cast< unsigned >( digests.size() ) );
 }
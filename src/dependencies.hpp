@@ -16,4 +16,12 @@
 
 void retrieve_dependencies( std::map< std::string, std::vector< std::string > > & deps, std::set< std::string > & buildable );
 
+// reads the SHA-256 digests of the package archives, which a release
+// can provide in sha256.txt.lzma, in the format of sha256sum; maps the
+// archive file name to the digest in lowercase hex. Leaves 'digests'
+// empty when the release has none; that the file is missing is cached
+// like the file itself would be. Call after retrieve_dependencies
+
+void retrieve_digests( std::map< std::string, std::string > & digests );
+
 #endif // #ifndef DEPENDENCIES_HPP_INCLUDED
@@ -0,0 +1,321 @@
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "event_reader.hpp"
+#include "tcp_reader.hpp"
+#include "error.hpp"
+#include <algorithm>
+#include <cstring>
+
+#if defined( __linux__ )
+
+#include <map>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <errno.h>
+
+class event_loop
+{
+private:
+
+    int ep_;
+
+    unsigned long long next_id_;
+    std::map< unsigned long long, event_reader * > readers_;
+
+    thread * th_;
+
+public:
+
+    // guards the loop state and the buffers of all event_readers
+    mutex mx;
+
+private:
+
+    static void thread_proc( void * pv )
+    {
+        static_cast< event_loop* >( pv )->run();
+    }
+
+    void arm( event_reader * pr )
+    {
+        epoll_event ev;
+        std::memset( &ev, 0, sizeof( ev ) );
+
+        ev.events = EPOLLIN | EPOLLONESHOT;
+        ev.data.u64 = pr->id_;
+
+        if( epoll_ctl( ep_, EPOLL_CTL_MOD, pr->pr_->handle(), &ev ) != 0 )
+        {
+            pr->error_ = errno;
+            pr->cn_data_.notify_one();
+        }
+    }
+
+    // reads from the socket until it has no more data or the buffer is full
+    void on_readable( event_reader * pr )
+    {
+        std::size_t const size = pr->buffer_.size();
+
+        for( ;; )
+        {
+            if( pr->count_ == size )
+            {
+                pr->paused_ = true;
+                return;
+            }
+
+            std::size_t tail = ( pr->head_ + pr->count_ ) % size;
+            std::size_t space = std::min( size - pr->count_, size - tail );
+
+            ssize_t r = ::recv( pr->pr_->handle(), &pr->buffer_[ tail ], space, MSG_DONTWAIT );
+
+            if( r > 0 )
+            {
+                pr->count_ += r;
+                pr->cn_data_.notify_one();
+            }
+            else if( r == 0 )
+            {
+                pr->eof_ = true;
+                pr->cn_data_.notify_one();
+
+                return;
+            }
+            else if( errno == EAGAIN || errno == EWOULDBLOCK )
+            {
+                arm( pr );
+                return;
+            }
+            else if( errno != EINTR )
+            {
+                pr->error_ = errno;
+                pr->cn_data_.notify_one();
+
+                return;
+            }
+        }
+    }
+
+    void run()
+    {
+        epoll_event events[ 64 ];
+
+        for( ;; )
+        {
+            int n = epoll_wait( ep_, events, 64, -1 );
+
+            scoped_lock lock( mx );
+
+            for( int i = 0; i < n; ++i )
+            {
+                // the reader may have been destroyed since the event was reported
+
+                std::map< unsigned long long, event_reader * >::iterator j = readers_.find( events[ i ].data.u64 );
+
+                if( j != readers_.end() )
+                {
+                    on_readable( j->second );
+                }
+            }
+        }
+    }
+
+public:
+
+    event_loop(): ep_( epoll_create( 64 ) ), next_id_( 0 ), th_( 0 )
+    {
+        if( ep_ < 0 )
+        {
+            throw_errno_error( "epoll", "event loop create error", errno );
+        }
+
+        th_ = new thread( thread_proc, this );
+    }
+
+    // called with 'mx' locked
+    void add( event_reader * pr )
+    {
+        pr->id_ = ++next_id_;
+
+        epoll_event ev;
+        std::memset( &ev, 0, sizeof( ev ) );
+
+        ev.events = EPOLLIN | EPOLLONESHOT;
+        ev.data.u64 = pr->id_;
+
+        if( epoll_ctl( ep_, EPOLL_CTL_ADD, pr->pr_->handle(), &ev ) != 0 )
+        {
+            throw_errno_error( pr->name(), "event loop register error", errno );
+        }
+
+        readers_[ pr->id_ ] = pr;
+    }
+
+    // called with 'mx' locked
+    void remove( event_reader * pr )
+    {
+        readers_.erase( pr->id_ );
+        epoll_ctl( ep_, EPOLL_CTL_DEL, pr->pr_->handle(), 0 );
+    }
+
+    // called with 'mx' locked, after 'pr' has been drained
+    void resume( event_reader * pr )
+    {
+        if( pr->paused_ )
+        {
+            pr->paused_ = false;
+            arm( pr );
+        }
+    }
+};
+
+static mutex s_mx;
+static event_loop * s_loop;
+
+static event_loop & get_loop()
+{
+    scoped_lock lock( s_mx );
+
+    if( s_loop == 0 )
+    {
+        // never destroyed; its thread ends with the process
+        s_loop = new event_loop;
+    }
+
+    return *s_loop;
+}
+
+bool event_reader::supported()
+{
+    return true;
+}
+
+event_reader::event_reader( tcp_reader * pr, std::size_t size ): pr_( pr ), id_( 0 ), buffer_( size > 0? size: 1 ), head_( 0 ), count_( 0 ), eof_( false ), error_( 0 ), paused_( false ), local_( 4096 ), local_pos_( 0 ), local_end_( 0 )
+{
+    event_loop & loop = get_loop();
+
+    scoped_lock lock( loop.mx );
+    loop.add( this );
+}
+
+event_reader::~event_reader()
+{
+    scoped_lock lock( s_loop->mx );
+    s_loop->remove( this );
+}
+
+// moves up to 'n' bytes from buffer_ to 'p', waiting for them
+std::size_t event_reader::take( void * p, std::size_t n )
+{
+    event_loop & loop = *s_loop; // created by our constructor
+
+    scoped_lock lock( loop.mx );
+
+    while( count_ == 0 && !eof_ && error_ == 0 )
+    {
+        cn_data_.wait( loop.mx );
+    }
+
+    if( count_ == 0 )
+    {
+        if( error_ != 0 )
+        {
+            throw_socket_error( name(), "TCP receive error", error_ );
+        }
+
+        return 0;
+    }
+
+    std::size_t const size = buffer_.size();
+
+    n = std::min( n, count_ );
+
+    std::size_t n1 = std::min( n, size - head_ );
+
+    std::memcpy( p, &buffer_[ head_ ], n1 );
+    std::memcpy( static_cast< char* >( p ) + n1, &buffer_[ 0 ], n - n1 );
+
+    head_ = ( head_ + n ) % size;
+    count_ -= n;
+
+    loop.resume( this );
+
+    return n;
+}
+
+std::size_t event_reader::read( void * p, std::size_t n )
+{
+    if( local_pos_ == local_end_ )
+    {
+        if( n >= local_.size() )
+        {
+            return take( p, n );
+        }
+
+        local_pos_ = 0;
+        local_end_ = take( &local_[ 0 ], local_.size() );
+    }
+
+    n = std::min( n, local_end_ - local_pos_ );
+
+    std::memcpy( p, &local_[ local_pos_ ], n );
+    local_pos_ += n;
+
+    return n;
+}
+
+bool event_reader::wait( double seconds )
+{
+    if( local_pos_ != local_end_ )
+    {
+        return true;
+    }
+
+    scoped_lock lock( s_loop->mx );
+
+    if( count_ == 0 && !eof_ && error_ == 0 )
+    {
+        cn_data_.wait_for( s_loop->mx, seconds );
+    }
+
+    return count_ != 0 || eof_ || error_ != 0;
+}
+
+#else
+
+bool event_reader::supported()
+{
+    return false;
+}
+
+event_reader::event_reader( tcp_reader * pr, std::size_t /*size*/ ): pr_( pr ), id_( 0 ), head_( 0 ), count_( 0 ), eof_( false ), error_( 0 ), paused_( false ), local_pos_( 0 ), local_end_( 0 )
+{
+    throw_error( name(), "event loop not supported on this platform" );
+}
+
+event_reader::~event_reader()
+{
+}
+
+std::size_t event_reader::read( void * /*p*/, std::size_t /*n*/ )
+{
+    return 0;
+}
+
+bool event_reader::wait( double /*seconds*/ )
+{
+    return true;
+}
+
+#endif // defined( __linux__ )
+
+std::string event_reader::name() const
+{
+    return pr_->name();
+}
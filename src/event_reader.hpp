@@ -0,0 +1,76 @@
+#ifndef EVENT_READER_HPP_INCLUDED
+#define EVENT_READER_HPP_INCLUDED
+
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "basic_reader.hpp"
+#include "thread.hpp"
+#include <vector>
+
+class tcp_reader;
+
+// reads from the socket of 'pr' through a bounded buffer of 'size' bytes,
+// which a single event loop thread, shared by all event_readers, fills
+// as data arrives. When the buffer is full, the socket is no longer
+// polled until the buffer is drained. Writing to 'pr' is unaffected.
+//
+// Only available when event_reader::supported() returns true (Linux);
+// elsewhere, use a buffered_reader with read-ahead.
+
+class event_reader: public basic_reader
+{
+private:
+
+    tcp_reader * pr_;
+    unsigned long long id_;
+
+    std::vector< char > buffer_;
+
+    std::size_t head_;
+    std::size_t count_;
+
+    bool eof_;
+    int error_;
+
+    // the socket is not being polled because the buffer is full
+    bool paused_;
+
+    condition cn_data_;
+
+    // data already taken from buffer_, so that small reads, such as those
+    // of the response headers a byte at a time, don't each lock the loop
+    std::vector< char > local_;
+
+    std::size_t local_pos_;
+    std::size_t local_end_;
+
+private:
+
+    event_reader( event_reader const & );
+    event_reader& operator=( event_reader const & );
+
+    std::size_t take( void * p, std::size_t n );
+
+    friend class event_loop;
+
+public:
+
+    event_reader( tcp_reader * pr, std::size_t size );
+    virtual ~event_reader();
+
+    static bool supported();
+
+    virtual std::string name() const;
+    virtual std::size_t read( void * p, std::size_t n );
+
+    // waits up to 'seconds' for data; returns true when a read would not block
+    bool wait( double seconds );
+};
+
+#endif // #ifndef EVENT_READER_HPP_INCLUDED
@@ -168,6 +168,41 @@ int fs_mkdir( std::string const & path, int /*mode*/ )
     return _mkdir( path.c_str() );
 }
 
+int fs_allocate( int /*fd*/, long long /*size*/ )
+{
+    return 0;
+}
+
+int fs_futime( int fd, std::time_t mtime, std::time_t atime )
+{
+    _utimbuf ut;
+
+    ut.actime = atime;
+    ut.modtime = mtime;
+
+    return _futime( fd, &ut );
+}
+
+int fs_open_dir( std::string const & /*path*/ )
+{
+    return 0;
+}
+
+int fs_close_dir( int /*dir*/ )
+{
+    return 0;
+}
+
+int fs_creat_at( int /*dir*/, std::string const & /*name*/, std::string const & path, int mode )
+{
+    return fs_creat( path, mode );
+}
+
+int fs_mkdir_at( int /*dir*/, std::string const & /*name*/, std::string const & path, int mode )
+{
+    return fs_mkdir( path, mode );
+}
+
 bool fs_exists( std::string const & path )
 {
     return _access( path.c_str(), 0 ) == 0;
@@ -191,6 +226,18 @@ int fs_stat( std::string const & path, int & mode, std::time_t & mtime, std::tim
     return r;
 }
 
+long long fs_size( std::string const & path )
+{
+    struct _stati64 st;
+
+    if( _stati64( path.c_str(), &st ) != 0 )
+    {
+        return -1;
+    }
+
+    return st.st_size;
+}
+
 int fs_utime( std::string const & path, std::time_t mtime, std::time_t atime )
 {
     _utimbuf ut;
@@ -206,6 +253,19 @@ int fs_rmdir( std::string const & path )
     return _rmdir( path.c_str() );
 }
 
+static void set_errno_from_last_error( DWORD r );
+
+int fs_rename( std::string const & from, std::string const & to )
+{
+    if( MoveFileExA( from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING ) )
+    {
+        return 0;
+    }
+
+    set_errno_from_last_error( GetLastError() );
+    return -1;
+}
+
 void fs_remove_all( std::string const & path, void (*removing)( std::string const & ), void (*error)( std::string const &, int ) )
 {
     removing( path );
@@ -651,6 +711,65 @@ int fs_mkdir( std::string const & path, int mode )
     return mkdir( path.c_str(), mode );
 }
 
+int fs_allocate( int fd, long long size )
+{
+#if defined( __linux__ )
+
+    if( size > 0 && fallocate( fd, 0, 0, size ) != 0 && errno != EOPNOTSUPP && errno != ENOSYS )
+    {
+        return -1;
+    }
+
+#else
+
+    (void)fd;
+    (void)size;
+
+#endif
+
+    return 0;
+}
+
+int fs_futime( int fd, std::time_t mtime, std::time_t atime )
+{
+    timespec ts[ 2 ] = {};
+
+    ts[ 0 ].tv_sec = atime;
+    ts[ 1 ].tv_sec = mtime;
+
+    return futimens( fd, ts );
+}
+
+int fs_open_dir( std::string const & path )
+{
+    return open( path.empty()? ".": path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+}
+
+int fs_close_dir( int dir )
+{
+    return close( dir );
+}
+
+int fs_creat_at( int dir, std::string const & name, std::string const & path, int mode )
+{
+    if( dir < 0 )
+    {
+        return fs_creat( path, mode );
+    }
+
+    return openat( dir, name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode );
+}
+
+int fs_mkdir_at( int dir, std::string const & name, std::string const & path, int mode )
+{
+    if( dir < 0 )
+    {
+        return fs_mkdir( path, mode );
+    }
+
+    return mkdirat( dir, name.c_str(), mode );
+}
+
 bool fs_exists( std::string const & path )
 {
     struct stat st;
@@ -676,6 +795,18 @@ int fs_stat( std::string const & path, int & mode, std::time_t & mtime, std::tim
     return r;
 }
 
+long long fs_size( std::string const & path )
+{
+    struct stat st;
+
+    if( stat( path.c_str(), &st ) != 0 )
+    {
+        return -1;
+    }
+
+    return st.st_size;
+}
+
 int fs_utime( std::string const & path, std::time_t mtime, std::time_t atime )
 {
     utimbuf ut;
@@ -691,11 +822,19 @@ int fs_rmdir( std::string const & path )
     return rmdir( path.c_str() );
 }
 
+int fs_rename( std::string const & from, std::string const & to )
+{
+    return std::rename( from.c_str(), to.c_str() );
+}
+
 void fs_remove_all( std::string const & path, void (*removing)( std::string const & ), void (*error)( std::string const &, int ) )
 {
     removing( path );
 
-    if( !fs_is_dir( path ) )
+    struct stat st;
+
+    // lstat, so that the contents of a symlinked directory are left alone
+    if( lstat( path.c_str(), &st ) != 0 || !S_ISDIR( st.st_mode ) )
     {
         // file or symlink
 
@@ -774,14 +913,13 @@ int fs_link_file( std::string const & link, std::string const & target )
 {
     std::string t2( target );
 
-    if( make_relative( link, t2 ) == 0 && symlink( t2.c_str(), link.c_str() ) == 0 )
-    {
-        return 0;
-    }
-    else
+    if( !make_relative( link, t2 ) )
     {
+        errno = EINVAL;
         return -1;
     }
+
+    return symlink( t2.c_str(), link.c_str() );
 }
 
 int fs_link_dir( std::string const & link, std::string const & target )
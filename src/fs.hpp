@@ -19,16 +19,37 @@ int fs_close( int fd );
 
 int fs_mkdir( std::string const & path, int mode );
 
+// reserves disk space for 'size' bytes, setting the file size, where the
+// file system supports it without writing zeroes (Linux); otherwise does
+// nothing. Returns 0 in both cases, -1 on error
+int fs_allocate( int fd, long long size );
+
+int fs_futime( int fd, std::time_t mtime, std::time_t atime );
+
+// an open directory, in which entries can be created by name with
+// openat and mkdirat, instead of walking their whole path again. On
+// Windows, and when 'dir' is -1, 'path' is used; it must name the
+// same entry
+int fs_open_dir( std::string const & path ); // -1 on error
+int fs_close_dir( int dir );
+
+int fs_creat_at( int dir, std::string const & name, std::string const & path, int mode );
+int fs_mkdir_at( int dir, std::string const & name, std::string const & path, int mode );
+
 bool fs_exists( std::string const & path );
 
 int fs_stat( std::string const & path, int & mode, std::time_t & mtime, std::time_t & ctime, std::time_t & atime );
 
 std::time_t fs_mtime( std::string const & path );
 
+long long fs_size( std::string const & path ); // -1 on error
+
 int fs_utime( std::string const & path, std::time_t mtime, std::time_t atime );
 
 int fs_rmdir( std::string const & path );
 
+int fs_rename( std::string const & from, std::string const & to ); // replaces 'to' if it exists
+
 void fs_remove_all( std::string const & path, void (*removing)( std::string const & ), void (*error)( std::string const &, int ) );
 
 int fs_readdir( std::string const & path, std::vector< std::string > & entries );
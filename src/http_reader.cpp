@@ -7,9 +7,23 @@
 //
 
 #include "http_reader.hpp"
+#include "tcp_reader.hpp"
+#include "buffered_reader.hpp"
+#include "event_reader.hpp"
+#include "config.hpp"
+#include "message.hpp"
+#include "thread.hpp"
+#include "mirrors.hpp"
 #include "error.hpp"
+#include <map>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
 #include <sstream>
 #include <cstdlib>
+#include <cstdio>
+#include <cctype>
 
 http_url_parser::http_url_parser( std::string const & url )
 {
@@ -18,8 +32,22 @@ http_url_parser::http_url_parser( std::string const & url )
         throw_error( url, "not an HTTP URL" );
     }
 
-    std::size_t i = url.find( ':', 7 );
-    std::size_t j = url.find( '/', 7 );
+    // an IPv6 address is enclosed in brackets: http://[::1]:8080/
+
+    std::size_t k = 7;
+
+    if( url.compare( 7, 1, "[" ) == 0 )
+    {
+        k = url.find( ']', 7 );
+
+        if( k == std::string::npos )
+        {
+            throw_error( url, "invalid IPv6 address" );
+        }
+    }
+
+    std::size_t i = url.find( ':', k );
+    std::size_t j = url.find( '/', k );
 
     if( j != std::string::npos )
     {
@@ -59,68 +87,1370 @@ std::string http_url_parser::request() const
     return request_;
 }
 
-http_reader::http_reader( std::string const & url ): http_url_parser( url ), tcp_reader( this->host(), this->port() ), name_( url )
+// connection pool
+
+class http_connection
 {
-    std::string rq = "GET " + this->request() + " HTTP/1.0\r\nHost: " + this->host() + "\r\nConnection: close\r\n\r\n";
+public:
+
+    tcp_reader tcp;
+
+    // with read_ahead, the event loop fills the input buffer where
+    // available, and a thread per connection elsewhere
+
+    buffered_reader * buffered;
+    event_reader * event;
+
+    basic_reader * in;
+
+    // the input buffer is filled in the background
+    bool background;
+
+    // requests that have been sent on this connection, and whose
+    // responses have not yet been read, as keys from request_key
+    std::deque< std::string > pending;
+
+    // a reader is using the connection
+    bool busy;
 
-    this->write( rq.data(), rq.size() );
+    // pipelined requests are being written by release
+    bool sending;
 
-    std::string line = this->read_line(); // HTTP/1.0 (code) (message)
+    // a pending request has been reissued on another connection,
+    // so the connection can't be reused
+    bool stale;
 
+public:
+
+    http_connection( std::string const & host, int port, std::size_t buffer_size, bool read_ahead ): tcp( host, port ), buffered( 0 ), event( 0 ), in( 0 ), background( read_ahead ), busy( false ), sending( false ), stale( false )
     {
-        std::istringstream is( line );
+        if( read_ahead && event_reader::supported() )
+        {
+            event = new event_reader( &tcp, buffer_size );
+            in = event;
+        }
+        else
+        {
+            buffered = new buffered_reader( &tcp, buffer_size, read_ahead );
+            in = buffered;
+        }
+    }
 
-        std::string http, message;
-        int code;
+    ~http_connection()
+    {
+        // unblock the read-ahead thread, if any
+        tcp.shutdown();
+
+        delete buffered;
+        delete event;
+    }
+
+    // waits up to 'seconds' for input; returns true when a read would not block
+    bool wait( double seconds )
+    {
+        if( event )
+        {
+            return event->wait( seconds );
+        }
+
+        return buffered->wait( seconds ) || ( !background && tcp.wait( seconds ) );
+    }
+
+    // adds a request to 'rq', to be sent with send, and to the pending ones
+    void add_request( std::string & rq, std::string const & host, std::string const & request, std::string const & headers, bool keep_alive )
+    {
+        rq += "GET " + request + ( keep_alive? " HTTP/1.1\r\nHost: ": " HTTP/1.0\r\nHost: " ) + host + "\r\n" + headers + ( keep_alive? "\r\n": "Connection: close\r\n\r\n" );
+
+        pending.push_back( request_key( request, headers ) );
+    }
+
+    void send( std::string const & rq )
+    {
+        tcp.write( rq.data(), rq.size() );
+    }
+
+    // a response can only be used for a request with the same headers,
+    // as they may ask for a range or make it conditional
+    static std::string request_key( std::string const & request, std::string const & headers )
+    {
+        return request + '\n' + headers;
+    }
+
+    // the request part of a key
+    static std::string request_of( std::string const & key )
+    {
+        return key.substr( 0, key.find( '\n' ) );
+    }
+};
+
+class http_pool
+{
+private:
+
+    mutex mx_;
+
+    // signalled when release has finished sending on a connection
+    condition sent_;
+
+    bool init_;
+
+    bool keep_alive_;
+    std::size_t depth_;
+
+    std::size_t buffer_size_;
+    bool read_ahead_;
+
+    double hedge_delay_;
+    double hedge_throughput_;
+
+    std::map< std::string, std::vector< http_connection * > > connections_;
+
+    // requests announced by http_pipeline, but not yet sent
+    std::map< std::string, std::deque< std::string > > queued_;
+
+private:
+
+    void init()
+    {
+        if( init_ ) return;
+
+        std::string v = config_get_option( "http_version" );
+
+        if( v.empty() || v == "1.0" )
+        {
+            keep_alive_ = false;
+        }
+        else if( v == "1.1" )
+        {
+            keep_alive_ = true;
+        }
+        else
+        {
+            throw std::runtime_error( "invalid http_version '" + v + "' in bpm.conf" );
+        }
+
+        int d = std::atoi( config_get_option( "http_pipeline" ).c_str() );
+        depth_ = d > 0? d: 0;
+
+        int b = std::atoi( config_get_option( "receive_buffer" ).c_str() );
+        buffer_size_ = b > 0? b: 65536;
+
+        read_ahead_ = config_get_option( "read_ahead" ) == "1";
+
+        hedge_delay_ = std::atof( config_get_option( "hedge_delay" ).c_str() );
+        hedge_throughput_ = std::atof( config_get_option( "hedge_throughput" ).c_str() ) * 1024;
+
+        init_ = true;
+    }
+
+    static std::string make_key( std::string const & host, int port )
+    {
+        char buffer[ 32 ];
+        std::sprintf( buffer, "%d", port );
+
+        return host + ':' + buffer;
+    }
+
+    void remove( std::string const & key, http_connection * pc )
+    {
+        std::vector< http_connection * > & v = connections_[ key ];
+        v.erase( std::remove( v.begin(), v.end(), pc ), v.end() );
+
+        delete pc;
+    }
+
+    // adds the queued requests that fit in the pipeline of 'pc' to 'rq'
+    void top_up( std::string const & host, std::string const & key, http_connection * pc, std::string & rq )
+    {
+        std::deque< std::string > & q = queued_[ key ];
+
+        while( !q.empty() && pc->pending.size() < depth_ )
+        {
+            msg_printf( 2, "pipelining request for '%s' on '%s'", q.front().c_str(), key.c_str() );
+
+            pc->add_request( rq, host, q.front(), std::string(), true );
+            q.pop_front();
+        }
+    }
+
+    // sends 'rq' on 'pc', which is busy, without holding the lock
+    void send( std::string const & key, http_connection * pc, std::string const & rq )
+    {
+        try
+        {
+            pc->send( rq );
+        }
+        catch( std::exception const & )
+        {
+            // the server has closed the connection
+            scoped_lock lock( mx_ );
+
+            remove( key, pc );
+            throw;
+        }
+    }
+
+public:
+
+    http_pool(): init_( false ), keep_alive_( false ), depth_( 0 ), buffer_size_( 0 ), read_ahead_( false ), hedge_delay_( 0 ), hedge_throughput_( 0 )
+    {
+    }
 
-        if( is >> http >> code >> message && http.substr( 0, 7 ) == "HTTP/1." && code >= 100 )
+    ~http_pool()
+    {
+        for( std::map< std::string, std::vector< http_connection * > >::iterator i = connections_.begin(); i != connections_.end(); ++i )
         {
-            if( code >= 300 )
+            for( std::vector< http_connection * >::iterator j = i->second.begin(); j != i->second.end(); ++j )
             {
-                throw_error( name_, "HTTP error: " + line );
+                delete *j;
             }
         }
-        else
+    }
+
+    bool keep_alive()
+    {
+        scoped_lock lock( mx_ );
+
+        init();
+        return keep_alive_;
+    }
+
+    http_connection * acquire( std::string const & host, int port, std::string const & request, std::string const & headers, bool & reused )
+    {
+        std::string key = make_key( host, port );
+        std::string rk = http_connection::request_key( request, headers );
+
+        std::string rq;
+        http_connection * idle = 0;
+
         {
-            throw_error( name_, "invalid server response: '" + line + "'" );
+            scoped_lock lock( mx_ );
+
+            init();
+
+            // a connection on which this request has already been sent;
+            // wait while release is still sending it
+
+            for( ;; )
+            {
+                std::vector< http_connection * > const & v = connections_[ key ];
+
+                bool sending = false;
+
+                for( std::vector< http_connection * >::const_iterator i = v.begin(); i != v.end(); ++i )
+                {
+                    http_connection * pc = *i;
+
+                    if( pc->stale || pc->pending.empty() || pc->pending.front() != rk ) continue;
+
+                    if( pc->sending )
+                    {
+                        sending = true;
+                    }
+                    else if( !pc->busy )
+                    {
+                        pc->busy = true;
+                        reused = true;
+
+                        return pc;
+                    }
+                }
+
+                if( !sending ) break;
+
+                sent_.wait( mx_ );
+            }
+
+            // the request is going to be sent now; responses to it
+            // pipelined on other connections will never be read
+
+            {
+                std::deque< std::string > & q = queued_[ key ];
+                q.erase( std::remove( q.begin(), q.end(), request ), q.end() );
+            }
+
+            std::vector< http_connection * > v = connections_[ key ];
+
+            for( std::vector< http_connection * >::iterator i = v.begin(); i != v.end(); ++i )
+            {
+                http_connection * pc = *i;
+
+                for( std::deque< std::string >::const_iterator j = pc->pending.begin(); j != pc->pending.end(); ++j )
+                {
+                    if( http_connection::request_of( *j ) == request )
+                    {
+                        pc->stale = true;
+                        break;
+                    }
+                }
+
+                if( pc->stale && !pc->busy )
+                {
+                    remove( key, pc );
+                }
+            }
+
+            // an idle connection
+
+            v = connections_[ key ];
+
+            for( std::vector< http_connection * >::iterator i = v.begin(); i != v.end(); ++i )
+            {
+                http_connection * pc = *i;
+
+                if( !pc->busy && pc->pending.empty() )
+                {
+                    pc->busy = true;
+                    reused = true;
+
+                    pc->add_request( rq, host, request, headers, keep_alive_ );
+                    top_up( host, key, pc, rq );
+
+                    idle = pc;
+                    break;
+                }
+            }
+        }
+
+        if( idle )
+        {
+            send( key, idle, rq );
+            return idle;
+        }
+
+        // a new connection, established without holding the lock
+
+        http_connection * pc = new http_connection( host, port, buffer_size_, read_ahead_ );
+
+        pc->busy = true;
+        reused = false;
+
+        {
+            scoped_lock lock( mx_ );
+
+            connections_[ key ].push_back( pc );
+
+            pc->add_request( rq, host, request, headers, keep_alive_ );
+            top_up( host, key, pc, rq );
+        }
+
+        send( key, pc, rq );
+        return pc;
+    }
+
+    void release( http_connection * pc, bool reusable )
+    {
+        std::string key = pc->tcp.name();
+        std::string rq;
+
+        {
+            scoped_lock lock( mx_ );
+
+            pc->busy = false;
+
+            if( !pc->pending.empty() )
+            {
+                pc->pending.pop_front();
+            }
+
+            if( !reusable || !keep_alive_ || pc->stale )
+            {
+                remove( key, pc );
+                return;
+            }
+
+            std::string host = key.substr( 0, key.rfind( ':' ) );
+
+            top_up( host, key, pc, rq );
+
+            if( rq.empty() )
+            {
+                return;
+            }
+
+            // keep the connection from being used until the requests are
+            // sent; acquire waits for the ones it's looking for
+
+            pc->busy = true;
+            pc->sending = true;
+        }
+
+        bool ok = true;
+
+        try
+        {
+            pc->send( rq );
+        }
+        catch( std::exception const & )
+        {
+            ok = false;
+        }
+
+        scoped_lock lock( mx_ );
+
+        pc->busy = false;
+        pc->sending = false;
+
+        if( !ok || pc->stale )
+        {
+            remove( key, pc );
+        }
+
+        sent_.notify_all();
+    }
+
+    // seconds without a response after which a request is sent again; 0 if disabled
+    double hedge_delay()
+    {
+        scoped_lock lock( mx_ );
+
+        init();
+        return hedge_delay_;
+    }
+
+    // bytes per second below which a transfer is duplicated; 0 if disabled
+    double hedge_throughput()
+    {
+        scoped_lock lock( mx_ );
+
+        init();
+        return hedge_throughput_;
+    }
+
+    bool pipelining()
+    {
+        scoped_lock lock( mx_ );
+
+        init();
+        return keep_alive_ && depth_ >= 2;
+    }
+
+    void pipeline( std::vector< std::string > const & urls )
+    {
+        scoped_lock lock( mx_ );
+
+        init();
+
+        if( !keep_alive_ || depth_ < 2 )
+        {
+            return;
+        }
+
+        for( std::vector< std::string >::const_iterator i = urls.begin(); i != urls.end(); ++i )
+        {
+            http_url_parser url( *i );
+            queued_[ make_key( url.host(), url.port() ) ].push_back( url.request() );
         }
     }
+};
+
+static http_pool s_pool;
+
+void http_pipeline( std::vector< std::string > const & urls )
+{
+    if( !s_pool.pipelining() )
+    {
+        return;
+    }
+
+    // choose the mirrors now, so that the requests can be sent ahead
+
+    std::vector< std::string > v;
+
+    for( std::vector< std::string >::const_iterator i = urls.begin(); i != urls.end(); ++i )
+    {
+        v.push_back( mirror_reserve( *i ) );
+    }
 
-    // skip rest of header
-    while( !read_line().empty() );
+    s_pool.pipeline( v );
 }
 
-http_reader::~http_reader()
+// http_reader
+
+http_reader::http_reader( std::string const & url ): http_url_parser( url ), name_( url ), pc_( 0 ), reused_( false ), keep_alive_( false ), eof_( false ), received_( 0 ), offset_( 0 ), hedges_( 0 ), window_start_( 0 ), window_received_( 0 )
 {
+    open( std::string() );
 }
 
-std::string http_reader::name() const
+http_reader::http_reader( std::string const & url, std::string const & headers ): http_url_parser( url ), name_( url ), pc_( 0 ), reused_( false ), keep_alive_( false ), eof_( false ), received_( 0 ), offset_( 0 ), hedges_( 0 ), window_start_( 0 ), window_received_( 0 )
 {
-    return name_;
+    open( headers );
 }
 
-std::string http_reader::read_line()
+// a second transfer for 'primary', used for hedging
+http_reader::http_reader( std::string const & name, http_reader const * primary ): http_url_parser( *primary ), name_( name ), pc_( 0 ), reused_( false ), keep_alive_( false ), eof_( false ), received_( 0 ), offset_( 0 ), hedges_( 0 ), window_start_( 0 ), window_received_( 0 )
 {
-    std::string r;
+}
+
+static bool is_redirect( int code )
+{
+    return code == 301 || code == 302 || code == 303 || code == 307 || code == 308;
+}
+
+void http_reader::open( std::string const & headers )
+{
+    request_headers_ = headers;
+
+    mirrors_ = mirror_urls( name_ );
 
     for( ;; )
     {
-        char ch;
+        std::string url = mirrors_.front();
+        mirrors_.erase( mirrors_.begin() );
 
-        std::size_t r2 = read( &ch, 1 );
-
-        if( r2 != 1 )
+        try
         {
-            throw_error( name_, "unexpected end of data" );
+            open_url( url, headers );
+            return;
         }
-
-        if( ch == '\n' ) break;
-
-        if( ch != '\r' )
+        catch( std::exception const & x )
         {
-            r += ch;
+            if( mirrors_.empty() ) throw;
+
+            msg_printf( 1, "%s; trying '%s'", x.what(), mirrors_.front().c_str() );
         }
     }
+}
 
-    return r;
+void http_reader::open_url( std::string const & url, std::string const & headers )
+{
+    start( url, headers );
+
+    double delay = s_pool.hedge_delay();
+
+    if( delay > 0 && !pc_->wait( delay ) )
+    {
+        hedge_response( headers, delay );
+    }
+
+    complete( headers );
+}
+
+// sends the request for 'url', without reading the response
+void http_reader::start( std::string const & url, std::string const & headers )
+{
+    static_cast< http_url_parser& >( *this ) = http_url_parser( url );
+
+    url_ = url;
+
+    mirror_begin( url_ );
+
+    offset_ = 0;
+    received_ = 0;
+    started_ = monotonic_clock();
+
+    try
+    {
+        pc_ = s_pool.acquire( this->host(), this->port(), this->request(), headers, reused_ );
+    }
+    catch( std::exception const & )
+    {
+        finish( false );
+        throw;
+    }
+}
+
+// reads the response to the request sent by start(), following redirects
+void http_reader::complete( std::string const & headers )
+{
+    int const max_redirects = 5;
+
+    try
+    {
+        for( int redirects = 0; ; ++redirects )
+        {
+            while( !read_response( reused_ ) )
+            {
+                // a reused connection has been closed by the server; retry on a new one
+
+                msg_printf( 2, "'%s': connection closed by server, retrying", name_.c_str() );
+
+                s_pool.release( pc_, false );
+                pc_ = 0;
+
+                pc_ = s_pool.acquire( this->host(), this->port(), this->request(), headers, reused_ );
+            }
+
+            if( !is_redirect( status_ ) )
+            {
+                return;
+            }
+
+            if( redirects == max_redirects )
+            {
+                throw_error( name_, "too many redirects" );
+            }
+
+            std::string location = resolve( header( "location" ) );
+
+            msg_printf( 1, "'%s': redirected to '%s'", name_.c_str(), location.c_str() );
+
+            // skip a short body, so that the connection can be reused
+
+            for( int i = 0; i < 16; ++i )
+            {
+                char buffer[ 4096 ];
+
+                if( read_body( buffer, sizeof( buffer ) ) == 0 ) break;
+            }
+
+            close();
+
+            static_cast< http_url_parser& >( *this ) = http_url_parser( location );
+
+            pc_ = s_pool.acquire( this->host(), this->port(), this->request(), headers, reused_ );
+        }
+    }
+    catch( std::exception const & )
+    {
+        keep_alive_ = false;
+
+        close();
+        finish( false );
+
+        throw;
+    }
+}
+
+// waits for input on either connection; returns true when 'other' has
+// it first, and false when this one does, or when neither has it within
+// the connect timeout, so that this one is kept
+
+bool http_reader::race( http_reader & other )
+{
+    double deadline = monotonic_clock() + tcp_connect_timeout;
+
+    while( monotonic_clock() < deadline )
+    {
+        if( pc_->wait( 0.01 ) ) return false;
+        if( other.pc_->wait( 0.01 ) ) return true;
+    }
+
+    return false;
+}
+
+// exchanges the transfers, but not the mirror list or the request headers
+void http_reader::swap_transfer( http_reader & other )
+{
+    {
+        http_url_parser tmp( *this );
+        static_cast< http_url_parser& >( *this ) = other;
+        static_cast< http_url_parser& >( other ) = tmp;
+    }
+
+    std::swap( url_, other.url_ );
+    std::swap( pc_, other.pc_ );
+    std::swap( reused_, other.reused_ );
+    std::swap( status_, other.status_ );
+    std::swap( headers_, other.headers_ );
+    std::swap( remaining_, other.remaining_ );
+    std::swap( keep_alive_, other.keep_alive_ );
+    std::swap( chunked_, other.chunked_ );
+    std::swap( chunk_remaining_, other.chunk_remaining_ );
+    std::swap( eof_, other.eof_ );
+    std::swap( content_length_, other.content_length_ );
+    std::swap( received_, other.received_ );
+    std::swap( progress_, other.progress_ );
+    std::swap( offset_, other.offset_ );
+    std::swap( started_, other.started_ );
+
+    // the old mirror becomes a fallback
+
+    mirrors_.erase( std::remove( mirrors_.begin(), mirrors_.end(), url_ ), mirrors_.end() );
+    mirrors_.push_back( other.url_ );
+}
+
+// the server hasn't responded within 'delay' seconds; sends the request
+// again, to the next mirror if any, and keeps whichever responds first
+void http_reader::hedge_response( std::string const & headers, double delay )
+{
+    std::string url = mirrors_.empty()? url_: mirrors_.front();
+
+    msg_printf( 1, "'%s': no response from '%s' after %.1f s, also trying '%s'", name_.c_str(), url_.c_str(), delay, url.c_str() );
+
+    http_reader other( name_, this );
+
+    try
+    {
+        other.start( url, headers );
+    }
+    catch( std::exception const & x )
+    {
+        msg_printf( 1, "%s", x.what() );
+        return;
+    }
+
+    if( race( other ) )
+    {
+        msg_printf( 1, "'%s': using the response from '%s'", name_.c_str(), url.c_str() );
+
+        swap_transfer( other );
+        other.finish( false );
+    }
+    else
+    {
+        other.cancel();
+    }
+}
+
+// the transfer has stalled, or has been slower than hedge_throughput;
+// requests the rest from the next mirror, if any, or on a new connection.
+// Switches to the new transfer if it responds before the current one
+// resumes (when stalled) or within two seconds (when slow)
+void http_reader::hedge_transfer( bool stalled )
+{
+    std::string url = mirrors_.empty()? url_: mirrors_.front();
+
+    long long offset = received_;
+
+    msg_printf( 1, "'%s': transfer from '%s' %s, also requesting '%s' at offset %lld", name_.c_str(), url_.c_str(), stalled? "has stalled": "is slow", url.c_str(), offset );
+
+    char buffer[ 64 ];
+    std::sprintf( buffer, "Range: bytes=%lld-\r\n", offset );
+
+    http_reader other( name_, this );
+
+    try
+    {
+        other.start( url, buffer );
+
+        if( stalled? !race( other ): !other.pc_->wait( 2 ) )
+        {
+            msg_printf( 1, "'%s': continuing the transfer from '%s'", name_.c_str(), url_.c_str() );
+
+            other.cancel();
+            return;
+        }
+
+        other.complete( buffer );
+
+        if( !other.continue_at( offset, content_length_, progress_ ) )
+        {
+            other.cancel();
+            return;
+        }
+    }
+    catch( std::exception const & x )
+    {
+        msg_printf( 1, "%s", x.what() );
+        return;
+    }
+
+    msg_printf( 1, "'%s': switched to '%s'", name_.c_str(), url.c_str() );
+
+    swap_transfer( other );
+
+    other.keep_alive_ = false;
+    other.finish( !stalled );
+}
+
+// with hedge_throughput, measures the throughput over two second
+// windows, and hedges a transfer that is too slow
+void http_reader::monitor()
+{
+    double const window = 2;
+
+    double threshold = s_pool.hedge_throughput();
+
+    if( threshold <= 0 || eof_ || hedges_ >= 2 || !request_headers_.empty() || status_ != 200 )
+    {
+        return;
+    }
+
+    if( window_start_ == 0 )
+    {
+        window_start_ = monotonic_clock();
+        window_received_ = received_;
+    }
+
+    for( ;; )
+    {
+        double elapsed = monotonic_clock() - window_start_;
+
+        if( elapsed >= window )
+        {
+            long long n = received_ - window_received_;
+
+            if( n / elapsed < threshold )
+            {
+                ++hedges_;
+                hedge_transfer( n == 0 );
+            }
+
+            window_start_ = monotonic_clock();
+            window_received_ = received_;
+
+            return;
+        }
+
+        if( pc_->wait( window - elapsed ) )
+        {
+            return;
+        }
+    }
+}
+
+// removes "." and ".." segments from an absolute path (RFC 3986, 5.2.4)
+static std::string remove_dot_segments( std::string const & path )
+{
+    std::string::size_type q = path.find_first_of( "?#" );
+
+    std::string query = q == std::string::npos? std::string(): path.substr( q );
+
+    std::vector< std::string > segments;
+
+    std::string::size_type i = 1, end = q == std::string::npos? path.size(): q;
+
+    while( i <= end )
+    {
+        std::string::size_type j = path.find( '/', i );
+
+        if( j == std::string::npos || j > end ) j = end;
+
+        std::string segment = path.substr( i, j - i );
+
+        if( segment == ".." )
+        {
+            if( !segments.empty() ) segments.pop_back();
+            if( j == end ) segments.push_back( std::string() );
+        }
+        else if( segment == "." )
+        {
+            if( j == end ) segments.push_back( std::string() );
+        }
+        else
+        {
+            segments.push_back( segment );
+        }
+
+        i = j + 1;
+    }
+
+    std::string r;
+
+    for( std::size_t k = 0; k < segments.size(); ++k )
+    {
+        r += '/';
+        r += segments[ k ];
+    }
+
+    if( r.empty() ) r = "/";
+
+    return r + query;
+}
+
+std::string http_reader::resolve( std::string const & location ) const
+{
+    if( location.find( "://" ) != std::string::npos )
+    {
+        // absolute; http_url_parser rejects schemes other than http
+        return location;
+    }
+
+    if( location.substr( 0, 2 ) == "//" )
+    {
+        return "http:" + location;
+    }
+
+    std::string origin = "http://" + this->host();
+
+    if( this->port() != 80 )
+    {
+        char buffer[ 32 ];
+        std::sprintf( buffer, ":%d", this->port() );
+
+        origin += buffer;
+    }
+
+    if( !location.empty() && location[ 0 ] == '/' )
+    {
+        return origin + remove_dot_segments( location );
+    }
+
+    std::string rq = this->request();
+
+    return origin + remove_dot_segments( rq.substr( 0, rq.rfind( '/' ) + 1 ) + location );
+}
+
+bool http_reader::read_response( bool reused )
+{
+    status_ = 0;
+    headers_.clear();
+
+    remaining_ = -1;
+    keep_alive_ = false;
+
+    chunked_ = false;
+    chunk_remaining_ = 0;
+
+    eof_ = false;
+
+    received_ = 0;
+    progress_ = 0;
+
+    std::string line;
+
+    try
+    {
+        line = this->read_line(); // HTTP/1.x (code) (message)
+    }
+    catch( std::exception const & )
+    {
+        if( reused ) return false;
+        throw;
+    }
+
+    bool http11 = false;
+
+    for( ;; )
+    {
+        std::istringstream is( line );
+
+        std::string http;
+        int code;
+
+        if( is >> http >> code && http.substr( 0, 7 ) == "HTTP/1." && code >= 100 )
+        {
+            status_ = code;
+            http11 = http != "HTTP/1.0";
+        }
+        else
+        {
+            throw_error( name_, "invalid server response: '" + line + "'" );
+        }
+
+        if( status_ >= 200 )
+        {
+            break;
+        }
+
+        // skip an interim 1xx response
+
+        while( !read_line().empty() );
+
+        line = read_line();
+    }
+
+    keep_alive_ = http11 && s_pool.keep_alive();
+
+    for( ;; )
+    {
+        std::string line2 = read_line();
+
+        if( line2.empty() ) break;
+
+        std::size_t i = line2.find( ':' );
+
+        if( i == std::string::npos ) continue;
+
+        std::string name = line2.substr( 0, i );
+        std::transform( name.begin(), name.end(), name.begin(), ::tolower );
+
+        std::size_t j = line2.find_first_not_of( " \t", i + 1 );
+        std::string value = j == std::string::npos? std::string(): line2.substr( j );
+
+        headers_[ name ] = value;
+
+        std::transform( value.begin(), value.end(), value.begin(), ::tolower );
+
+        if( name == "content-length" )
+        {
+            remaining_ = std::strtoll( value.c_str(), 0, 10 );
+        }
+        else if( name == "connection" && value == "close" )
+        {
+            keep_alive_ = false;
+        }
+        else if( name == "transfer-encoding" && value != "identity" )
+        {
+            if( value != "chunked" )
+            {
+                throw_error( name_, "unsupported transfer encoding: '" + value + "'" );
+            }
+
+            chunked_ = true;
+        }
+    }
+
+    if( status_ >= 300 && status_ != 304 && status_ != 416 && !( is_redirect( status_ ) && !header( "location" ).empty() ) )
+    {
+        throw_error( name_, "HTTP error: " + line );
+    }
+
+    if( chunked_ )
+    {
+        // Content-Length is ignored with chunked encoding
+        remaining_ = -1;
+    }
+
+    if( status_ == 304 || status_ == 204 )
+    {
+        // no body
+        chunked_ = false;
+        remaining_ = 0;
+    }
+
+    if( status_ == 416 )
+    {
+        // the body, if any, describes the error
+        keep_alive_ = false;
+    }
+
+    if( remaining_ < 0 && !chunked_ )
+    {
+        // body delimited by end of connection
+        keep_alive_ = false;
+    }
+
+    content_length_ = remaining_;
+    eof_ = remaining_ == 0;
+
+    return true;
+}
+
+void http_reader::close()
+{
+    if( pc_ )
+    {
+        s_pool.release( pc_, keep_alive_ && eof_ );
+        pc_ = 0;
+    }
+}
+
+// reports the transfer from url_ to mirrors.hpp
+void http_reader::finish( bool ok )
+{
+    if( !url_.empty() )
+    {
+        mirror_end( url_, ok, received_ - offset_, monotonic_clock() - started_ );
+        url_.clear();
+    }
+}
+
+// ends the transfer from url_ without reporting it, when it has been
+// abandoned for another one
+void http_reader::cancel()
+{
+    if( !url_.empty() )
+    {
+        mirror_cancel( url_ );
+        url_.clear();
+    }
+}
+
+http_reader::~http_reader()
+{
+    close();
+    finish( true );
+}
+
+// after a request for the range starting at 'offset' of a body of
+// 'length' bytes, checks the response and skips to 'offset' if needed
+bool http_reader::continue_at( long long offset, long long length, int progress )
+{
+    std::string range = header( "content-range" ); // bytes first-last/length
+
+    if( status_ == 206 && range.substr( 0, 6 ) == "bytes " && std::strtoll( range.c_str() + 6, 0, 10 ) == offset )
+    {
+        status_ = 200;
+
+        content_length_ = length;
+        received_ = offset_ = offset;
+        progress_ = progress;
+
+        return true;
+    }
+
+    if( status_ == 200 && ( length < 0 || content_length_ == length ) )
+    {
+        // the server ignored the range; skip to the offset
+
+        msg_printf( 1, "'%s': '%s' does not support ranges, skipping %lld bytes", name_.c_str(), url_.c_str(), offset );
+
+        progress_ = progress;
+
+        while( received_ < offset )
+        {
+            char buffer[ 4096 ];
+
+            std::size_t n = static_cast< std::size_t >( std::min< long long >( sizeof( buffer ), offset - received_ ) );
+
+            if( read_body( buffer, n ) == 0 )
+            {
+                throw_error( name_, "unexpected end of data" );
+            }
+        }
+
+        return true;
+    }
+
+    msg_printf( 1, "'%s': '%s' did not return the requested range", name_.c_str(), url_.c_str() );
+
+    return false;
+}
+
+// continues an interrupted download from the next mirror
+bool http_reader::failover()
+{
+    long long offset = received_;
+    long long length = content_length_;
+    int progress = progress_;
+
+    keep_alive_ = false;
+
+    close();
+    finish( false );
+
+    while( !mirrors_.empty() )
+    {
+        std::string url = mirrors_.front();
+        mirrors_.erase( mirrors_.begin() );
+
+        msg_printf( 1, "'%s': continuing from '%s' at offset %lld", name_.c_str(), url.c_str(), offset );
+
+        char buffer[ 64 ];
+        std::sprintf( buffer, "Range: bytes=%lld-\r\n", offset );
+
+        try
+        {
+            open_url( url, buffer );
+
+            if( continue_at( offset, length, progress ) )
+            {
+                return true;
+            }
+        }
+        catch( std::exception const & x )
+        {
+            msg_printf( 1, "%s", x.what() );
+            continue;
+        }
+
+        keep_alive_ = false;
+
+        close();
+        finish( false );
+    }
+
+    return false;
+}
+
+std::string http_reader::name() const
+{
+    return name_;
+}
+
+int http_reader::status() const
+{
+    return status_;
+}
+
+std::string http_reader::header( std::string const & name ) const
+{
+    std::map< std::string, std::string >::const_iterator i = headers_.find( name );
+    return i == headers_.end()? std::string(): i->second;
+}
+
+long long http_reader::content_length() const
+{
+    return content_length_;
+}
+
+std::string http_reader::validator() const
+{
+    std::string etag = header( "etag" );
+
+    // a weak ETag can't be used in If-Range
+    if( !etag.empty() && etag.substr( 0, 2 ) != "W/" )
+    {
+        return etag;
+    }
+
+    return header( "last-modified" );
+}
+
+bool http_reader::next_chunk()
+{
+    std::string line = read_line(); // size [; extensions]
+
+    char * end = 0;
+    long long size = std::strtoll( line.c_str(), &end, 16 );
+
+    if( end == line.c_str() || size < 0 || ( *end != 0 && *end != ';' && *end != ' ' && *end != '\t' ) )
+    {
+        keep_alive_ = false;
+        throw_error( name_, "invalid chunk header: '" + line + "'" );
+    }
+
+    if( size == 0 )
+    {
+        // last chunk, skip trailers
+        while( !read_line().empty() );
+        return false;
+    }
+
+    chunk_remaining_ = size;
+    return true;
+}
+
+void http_reader::report_progress()
+{
+    long long const threshold = 1048576;
+
+    if( content_length_ < threshold )
+    {
+        return;
+    }
+
+    int p = static_cast< int >( received_ * 4 / content_length_ ); // quarters
+
+    if( p > progress_ )
+    {
+        progress_ = p;
+        msg_printf( 1, "'%s': received %lld of %lld KB", name_.c_str(), received_ / 1024, content_length_ / 1024 );
+    }
+}
+
+std::size_t http_reader::read( void * p, std::size_t n )
+{
+    for( ;; )
+    {
+        try
+        {
+            monitor();
+            return read_body( p, n );
+        }
+        catch( std::exception const & x )
+        {
+            // only a plain request for the whole resource can be
+            // continued elsewhere
+
+            if( !request_headers_.empty() || status_ != 200 || mirrors_.empty() )
+            {
+                finish( false );
+                throw;
+            }
+
+            msg_printf( 1, "%s", x.what() );
+
+            if( !failover() )
+            {
+                throw;
+            }
+        }
+    }
+}
+
+std::size_t http_reader::read_body( void * p, std::size_t n )
+{
+    if( eof_ || n == 0 )
+    {
+        return 0;
+    }
+
+    if( chunked_ )
+    {
+        if( chunk_remaining_ == 0 && !next_chunk() )
+        {
+            eof_ = true;
+            return 0;
+        }
+
+        if( static_cast< unsigned long long >( chunk_remaining_ ) < n )
+        {
+            n = static_cast< std::size_t >( chunk_remaining_ );
+        }
+    }
+    else if( remaining_ >= 0 && static_cast< unsigned long long >( remaining_ ) < n )
+    {
+        n = static_cast< std::size_t >( remaining_ );
+    }
+
+    std::size_t r = pc_->in->read( p, n );
+
+    if( r == 0 )
+    {
+        if( chunked_ || remaining_ >= 0 )
+        {
+            keep_alive_ = false;
+            throw_error( name_, "connection closed before end of data" );
+        }
+
+        eof_ = true;
+        return 0;
+    }
+
+    received_ += r;
+
+    if( chunked_ )
+    {
+        chunk_remaining_ -= r;
+
+        if( chunk_remaining_ == 0 && !read_line().empty() )
+        {
+            keep_alive_ = false;
+            throw_error( name_, "invalid chunk terminator" );
+        }
+    }
+    else if( remaining_ >= 0 )
+    {
+        remaining_ -= r;
+        eof_ = remaining_ == 0;
+    }
+
+    report_progress();
+
+    return r;
+}
+
+std::string http_reader::read_line()
+{
+    std::string r;
+
+    for( ;; )
+    {
+        char ch;
+
+        std::size_t r2 = pc_->in->read( &ch, 1 );
+
+        if( r2 != 1 )
+        {
+            keep_alive_ = false;
+            throw_error( name_, "unexpected end of data" );
+        }
+
+        if( ch == '\n' ) break;
+
+        if( ch != '\r' )
+        {
+            r += ch;
+        }
+    }
+
+    return r;
+}
+
+// true when the server reported the file as not found, that is, when
+// the reason of the error is "HTTP error: HTTP/1.1 404 Not Found"
+
+bool http_is_not_found( std::exception const & x )
+{
+    error const * e = dynamic_cast< error const* >( &x );
+
+    if( e == 0 )
+    {
+        return false;
+    }
+
+    std::string reason = e->reason();
+    std::string const prefix = "HTTP error: ";
+
+    if( reason.compare( 0, prefix.size(), prefix ) != 0 )
+    {
+        return false;
+    }
+
+    std::string::size_type i = reason.find( ' ', prefix.size() );
+
+    return i != std::string::npos && std::atoi( reason.c_str() + i + 1 ) == 404;
 }
@@ -9,7 +9,11 @@
 // http://www.boost.org/LICENSE_1_0.txt
 //
 
-#include "tcp_reader.hpp"
+#include "basic_reader.hpp"
+#include <string>
+#include <vector>
+#include <map>
+#include <exception>
 
 class http_url_parser
 {
@@ -30,12 +34,47 @@ public:
     std::string request() const;
 };
 
-class http_reader: private http_url_parser, public tcp_reader
+class http_connection;
+
+class http_reader: private http_url_parser, public basic_reader
 {
 private:
 
     std::string name_;
 
+    // the URL being read, and the mirrors to fall back to (mirrors.hpp)
+    std::string url_;
+    std::vector< std::string > mirrors_;
+
+    std::string request_headers_;
+
+    http_connection * pc_;
+    bool reused_;
+
+    int status_;
+    std::map< std::string, std::string > headers_; // names in lowercase
+
+    long long remaining_; // -1 when the body isn't delimited by Content-Length
+    bool keep_alive_;
+
+    bool chunked_;
+    long long chunk_remaining_;
+
+    bool eof_;
+
+    long long content_length_;
+    long long received_;
+    int progress_;
+
+    // for the throughput of the mirror
+    long long offset_;
+    double started_;
+
+    // for hedging
+    int hedges_;
+    double window_start_;
+    long long window_received_;
+
 private:
 
     http_reader( http_reader const & );
@@ -43,12 +82,75 @@ private:
 
     std::string read_line();
 
+    http_reader( std::string const & name, http_reader const * primary );
+
+    void open( std::string const & headers );
+    void open_url( std::string const & url, std::string const & headers );
+    void start( std::string const & url, std::string const & headers );
+    void complete( std::string const & headers );
+    bool read_response( bool reused );
+    std::string resolve( std::string const & location ) const;
+    void close();
+    void finish( bool ok );
+    void cancel();
+
+    bool continue_at( long long offset, long long length, int progress );
+    bool failover();
+
+    bool race( http_reader & other );
+    void swap_transfer( http_reader & other );
+    void hedge_response( std::string const & headers, double delay );
+    void hedge_transfer( bool stalled );
+    void monitor();
+
+    bool next_chunk();
+    void report_progress();
+    std::size_t read_body( void * p, std::size_t n );
+
 public:
 
+    // redirects are followed, up to five times. When 'url' is under a
+    // mirrored package path, the mirrors are tried in turn, and a download
+    // interrupted by an error continues from the next one.
     explicit http_reader( std::string const & url );
+
+    // 'headers' are additional request header lines, each terminated by \r\n
+    http_reader( std::string const & url, std::string const & headers );
+
     ~http_reader();
 
+    // the original URL, even after a redirect or a switch to a mirror
     virtual std::string name() const;
+
+    // throws when the connection is closed before the end of a body
+    // delimited by Content-Length or chunked encoding
+    virtual std::size_t read( void * p, std::size_t n );
+
+    // status codes >= 300 throw, except for 304 (Not Modified) and 416
+    // (Range Not Satisfiable), which only occur in response to conditional
+    // or range requests
+    int status() const;
+
+    // returns the value of the response header 'name' (in lowercase), or an empty string
+    std::string header( std::string const & name ) const;
+
+    // -1 when not known in advance
+    long long content_length() const;
+
+    // the strong ETag of the response, or else its Last-Modified date, for
+    // an If-Range header; empty when it has neither
+    std::string validator() const;
 };
 
+// When http_version=1.1 in bpm.conf, connections are kept alive and reused
+// for subsequent requests to the same host. If, in addition, http_pipeline=N
+// is set, http_pipeline announces the URLs that are going to be requested in
+// that order, so that up to N requests can be sent ahead on one connection.
+
+void http_pipeline( std::vector< std::string > const & urls );
+
+// true when 'x' is the error thrown for a 404 (Not Found) response
+
+bool http_is_not_found( std::exception const & x );
+
 #endif // #ifndef HTTP_READER_HPP_INCLUDED
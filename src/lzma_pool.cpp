@@ -0,0 +1,184 @@
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "lzma_pool.hpp"
+#include "thread.hpp"
+#include <map>
+#include <vector>
+#include <cstddef>
+#include <new>
+#include <stdlib.h>
+
+// each block is preceded by its capacity, in a header that keeps the
+// alignment of malloc
+
+union pool_header
+{
+    std::size_t capacity;
+    long double ld_;
+    void * pv_;
+    long long ll_;
+};
+
+// free blocks are kept up to this total; there are rarely more than
+// one dictionary and one probability table per concurrent decoder
+static std::size_t const max_pooled = 256 << 20;
+
+class block_pool
+{
+private:
+
+    mutex mx_;
+
+    std::map< std::size_t, std::vector< pool_header* > > free_;
+    std::size_t pooled_;
+
+private:
+
+    block_pool( block_pool const & );
+    block_pool& operator=( block_pool const & );
+
+public:
+
+    block_pool(): pooled_( 0 )
+    {
+    }
+
+    ~block_pool()
+    {
+        for( std::map< std::size_t, std::vector< pool_header* > >::iterator i = free_.begin(); i != free_.end(); ++i )
+        {
+            for( std::vector< pool_header* >::iterator j = i->second.begin(); j != i->second.end(); ++j )
+            {
+                free( *j );
+            }
+        }
+    }
+
+    void * allocate( std::size_t size )
+    {
+        std::size_t capacity = 4096;
+
+        while( capacity < size )
+        {
+            if( capacity > ~static_cast< std::size_t >( 0 ) / 2 - sizeof( pool_header ) )
+            {
+                return 0;
+            }
+
+            capacity *= 2;
+        }
+
+        pool_header * ph = 0;
+
+        {
+            scoped_lock lock( mx_ );
+
+            std::map< std::size_t, std::vector< pool_header* > >::iterator i = free_.find( capacity );
+
+            if( i != free_.end() && !i->second.empty() )
+            {
+                ph = i->second.back();
+                i->second.pop_back();
+
+                pooled_ -= capacity;
+            }
+        }
+
+        if( ph == 0 )
+        {
+            ph = static_cast< pool_header* >( malloc( sizeof( pool_header ) + capacity ) );
+
+            if( ph == 0 )
+            {
+                return 0;
+            }
+
+            ph->capacity = capacity;
+        }
+
+        return ph + 1;
+    }
+
+    void deallocate( void * p )
+    {
+        if( p == 0 )
+        {
+            return;
+        }
+
+        pool_header * ph = static_cast< pool_header* >( p ) - 1;
+
+        {
+            scoped_lock lock( mx_ );
+
+            // called from C, so must not throw
+            try
+            {
+                if( pooled_ + ph->capacity <= max_pooled )
+                {
+                    free_[ ph->capacity ].push_back( ph );
+                    pooled_ += ph->capacity;
+
+                    return;
+                }
+            }
+            catch( ... )
+            {
+            }
+        }
+
+        free( ph );
+    }
+};
+
+static block_pool s_pool;
+
+static void* pool_alloc( void*, size_t size )
+{
+    return s_pool.allocate( size );
+}
+
+static void pool_free( void*, void * address )
+{
+    s_pool.deallocate( address );
+}
+
+static ISzAlloc s_alloc = { pool_alloc, pool_free };
+
+ISzAlloc * lzma_pool()
+{
+    return &s_alloc;
+}
+
+void pool_buffer::resize( std::size_t n )
+{
+    release();
+
+    if( n == 0 )
+    {
+        return;
+    }
+
+    p_ = static_cast< unsigned char* >( s_pool.allocate( n ) );
+
+    if( p_ == 0 )
+    {
+        throw std::bad_alloc();
+    }
+
+    n_ = n;
+}
+
+void pool_buffer::release()
+{
+    s_pool.deallocate( p_ );
+
+    p_ = 0;
+    n_ = 0;
+}
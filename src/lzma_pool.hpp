@@ -0,0 +1,76 @@
+#ifndef LZMA_POOL_HPP_INCLUDED
+#define LZMA_POOL_HPP_INCLUDED
+
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "lzma/7zTypes.h"
+#include <cstddef>
+
+// an allocator for the LZMA decoders that keeps the blocks they free,
+// rounded up to a power of two, and hands them out again to the next
+// decoder that needs one of the same size; so archives with the same
+// properties reuse the probability tables and the dictionary of their
+// predecessor, pages already mapped in. Safe to use from any thread
+
+ISzAlloc * lzma_pool();
+
+// a buffer allocated from the same pool, for the data the decoders
+// work on; unlike std::vector, it doesn't initialize its contents
+
+class pool_buffer
+{
+private:
+
+    unsigned char * p_;
+    std::size_t n_;
+
+private:
+
+    pool_buffer( pool_buffer const & );
+    pool_buffer& operator=( pool_buffer const & );
+
+public:
+
+    pool_buffer(): p_( 0 ), n_( 0 )
+    {
+    }
+
+    ~pool_buffer()
+    {
+        release();
+    }
+
+    // discards the contents; throws std::bad_alloc
+    void resize( std::size_t n );
+
+    // returns the memory to the pool
+    void release();
+
+    std::size_t size() const
+    {
+        return n_;
+    }
+
+    bool empty() const
+    {
+        return n_ == 0;
+    }
+
+    unsigned char & operator[]( std::size_t i )
+    {
+        return p_[ i ];
+    }
+
+    unsigned char const & operator[]( std::size_t i ) const
+    {
+        return p_[ i ];
+    }
+};
+
+#endif // #ifndef LZMA_POOL_HPP_INCLUDED
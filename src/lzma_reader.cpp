@@ -7,25 +7,16 @@
 //
 
 #include "lzma_reader.hpp"
+#include "lzma_pool.hpp"
 #include "error.hpp"
 #include "lzma/LzmaDec.h"
-#include <stdlib.h>
+#include <algorithm>
+#include <cstring>
 
-void* SzAlloc( void*, size_t size )
-{
-    return malloc( size );
-}
-
-void SzFree( void*, void * address )
-{
-    free( address );
-}
-
-static ISzAlloc s_alloc = { SzAlloc, SzFree };
-
-lzma_reader::lzma_reader( basic_reader * pr ): pr_( pr ), k_( 0 ), m_( 0 )
+lzma_reader::lzma_reader( basic_reader * pr ): pr_( pr ), in_( 0 ), m_( 0 ), out_( 0 ), capped_( false ), finished_( false )
 {
     typedef char assert_large_enough[ sizeof( state_ ) >= sizeof( CLzmaDec )? 1: -1 ];
+    (void)sizeof( assert_large_enough );
 
     {
         std::size_t r = pr_->read( header_, sizeof( header_ ) );
@@ -40,8 +31,10 @@ lzma_reader::lzma_reader( basic_reader * pr ): pr_( pr ), k_( 0 ), m_( 0 )
 
     LzmaDec_Construct( st );
 
+    ISzAlloc * alloc = lzma_pool();
+
     {
-        SRes r = LzmaDec_Allocate( st, header_, LZMA_PROPS_SIZE, &s_alloc );
+        SRes r = LzmaDec_AllocateProbs( st, header_, LZMA_PROPS_SIZE, alloc );
 
         if( r != SZ_OK )
         {
@@ -49,13 +42,40 @@ lzma_reader::lzma_reader( basic_reader * pr ): pr_( pr ), k_( 0 ), m_( 0 )
         }
     }
 
+    // the unpacked size follows the properties; all ones when unknown
+
+    unsigned long long size = 0;
+
+    for( int i = 12; i >= LZMA_PROPS_SIZE; --i )
+    {
+        size = size << 8 | header_[ i ];
+    }
+
+    SizeT dic_size = st->prop.dicSize;
+
+    if( size < dic_size )
+    {
+        dic_size = static_cast< SizeT >( size );
+        capped_ = true;
+    }
+
+    st->dic = static_cast< Byte* >( alloc->Alloc( alloc, std::max< SizeT >( dic_size, 1 ) ) );
+
+    if( st->dic == 0 )
+    {
+        LzmaDec_FreeProbs( st, alloc );
+        throw_error( pr_->name(), "could not allocate LZMA dictionary" );
+    }
+
+    st->dicBufSize = dic_size;
+
     LzmaDec_Init( st );
 }
 
 lzma_reader::~lzma_reader()
 {
     CLzmaDec * st = (CLzmaDec*)state_;
-    LzmaDec_Free( st, &s_alloc );
+    LzmaDec_Free( st, lzma_pool() );
 }
 
 std::string lzma_reader::name() const
@@ -63,46 +83,114 @@ std::string lzma_reader::name() const
     return pr_->name();
 }
 
-std::size_t lzma_reader::read( void * p, std::size_t n )
+// decodes the next part of the stream into the dictionary, past out_;
+// leaves out_ == dicPos at the end of the stream
+
+void lzma_reader::decode()
 {
     CLzmaDec * st = (CLzmaDec*)state_;
-    unsigned char * p2 = static_cast< unsigned char* >( p );
 
-    std::size_t r2 = 0;
+    if( st->dicPos == st->dicBufSize )
+    {
+        if( capped_ )
+        {
+            // the dictionary holds the whole stream
+            finished_ = true;
+        }
 
-    while( n > 0 )
+        st->dicPos = 0;
+    }
+
+    out_ = st->dicPos;
+
+    while( !finished_ && st->dicPos == out_ )
     {
         if( m_ == 0 )
         {
-            std::size_t r = pr_->read( buffer_, N );
+            // take the input in place when possible, in large blocks,
+            // as the decoder doesn't retain it between calls
 
-            if( r == 0 ) return r2;
+            void const * p3 = 0;
+            std::size_t r = 1048576;
+
+            if( pr_->read_direct( p3, r ) )
+            {
+                in_ = static_cast< unsigned char const* >( p3 );
+            }
+            else
+            {
+                r = pr_->read( buffer_, N );
+                in_ = buffer_;
+            }
+
+            if( r == 0 )
+            {
+                finished_ = true;
+                break;
+            }
 
-            k_ = 0;
             m_ = r;
         }
 
+        SizeT m2 = m_;
+
+        ELzmaStatus status = LZMA_STATUS_NOT_SPECIFIED;
+
+        SRes r = LzmaDec_DecodeToDic( st, st->dicBufSize, in_, &m2, LZMA_FINISH_ANY, &status );
+
+        if( r != SZ_OK )
         {
-            std::size_t n2 = n;
-            std::size_t m2 = m_;
+            throw_error( pr_->name(), "LZMA data error" );
+        }
 
-            ELzmaStatus status = LZMA_STATUS_NOT_SPECIFIED;
+        in_ += m2;
+        m_ -= m2;
 
-            SRes r = LzmaDec_DecodeToBuf( st, p2, &n2, buffer_ + k_, &m2, LZMA_FINISH_ANY, &status );
+        if( status == LZMA_STATUS_FINISHED_WITH_MARK || ( m2 == 0 && st->dicPos == out_ ) )
+        {
+            finished_ = true;
+        }
+    }
+}
 
-            if( r != 0 )
-            {
-                return -( 1000 + r );
-            }
+bool lzma_reader::read_direct( void const * & p, std::size_t & n )
+{
+    CLzmaDec * st = (CLzmaDec*)state_;
+
+    if( out_ == st->dicPos )
+    {
+        decode();
+    }
 
-            k_ += m2;
-            m_ -= m2;
+    n = std::min( n, st->dicPos - out_ );
 
-            p2 += n2;
-            n -= n2;
+    p = st->dic + out_;
+    out_ += n;
 
-            r2 += n2;
-        }
+    return true;
+}
+
+std::size_t lzma_reader::read( void * p, std::size_t n )
+{
+    unsigned char * p2 = static_cast< unsigned char* >( p );
+
+    std::size_t r2 = 0;
+
+    while( n > 0 )
+    {
+        void const * p3 = 0;
+        std::size_t n3 = n;
+
+        read_direct( p3, n3 );
+
+        if( n3 == 0 ) break;
+
+        std::memcpy( p2, p3, n3 );
+
+        p2 += n3;
+        n -= n3;
+
+        r2 += n3;
     }
 
     return r2;
@@ -18,18 +18,35 @@ private:
     basic_reader * pr_;
 
     unsigned char header_[ 13 ];
-    unsigned char state_[ 128 ];
+    void * state_[ 32 ]; // CLzmaDec
 
-    static int const N = 4096;
+    static int const N = 65536;
 
     unsigned char buffer_[ N ];
-    int k_, m_;
+
+    // the unconsumed input; points into buffer_, or into the memory
+    // of *pr_ when it supports read_direct
+    unsigned char const * in_;
+    std::size_t m_;
+
+    // the start of the decoded data in the dictionary that hasn't
+    // been returned yet; it extends to CLzmaDec::dicPos
+    std::size_t out_;
+
+    // the dictionary is only as large as the unpacked size given in
+    // header_, when that is smaller; decoding then stops there, rather
+    // than wrapping around
+    bool capped_;
+
+    bool finished_;
 
 private:
 
     lzma_reader( lzma_reader const & );
     lzma_reader& operator=( lzma_reader const & );
 
+    void decode();
+
 public:
 
     explicit lzma_reader( basic_reader * pr );
@@ -38,6 +55,9 @@ public:
 
     virtual std::string name() const;
     virtual std::size_t read( void * p, std::size_t n );
+
+    // returns the decoded data in place, from the dictionary
+    virtual bool read_direct( void const * & p, std::size_t & n );
 };
 
 #endif // #ifndef LZMA_READER_HPP_INCLUDED
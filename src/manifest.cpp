@@ -0,0 +1,105 @@
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "manifest.hpp"
+#include "error.hpp"
+#include "message.hpp"
+#include "string.hpp"
+#include "fs.hpp"
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <errno.h>
+
+void manifest_write( std::string const & fn, std::vector< manifest_entry > const & entries )
+{
+    std::ofstream os( fn.c_str(), std::ios_base::binary );
+
+    for( std::vector< manifest_entry >::const_iterator i = entries.begin(); i != entries.end(); ++i )
+    {
+        os << i->type << ' ' << std::oct << i->mode << std::dec << ' ' << i->mtime << ' ' << i->size << ' ' << i->path << '\n';
+    }
+
+    os.close();
+
+    if( !os )
+    {
+        throw_errno_error( fn, "write error", errno );
+    }
+}
+
+bool manifest_read( std::string const & fn, std::vector< manifest_entry > & entries )
+{
+    std::ifstream is( fn.c_str(), std::ios_base::binary );
+
+    if( !is )
+    {
+        return false;
+    }
+
+    entries.clear();
+
+    std::string line;
+
+    while( std::getline( is, line ) )
+    {
+        remove_trailing( line, '\r' );
+
+        std::istringstream ls( line );
+
+        manifest_entry e;
+
+        if( !( ls >> e.type >> std::oct >> e.mode >> std::dec >> e.mtime >> e.size ) || ls.get() != ' ' || !std::getline( ls, e.path ) || e.path.empty() || ( e.type != 'd' && e.type != 'f' ) )
+        {
+            msg_printf( 1, "'%s': bad manifest line '%s'", fn.c_str(), line.c_str() );
+
+            entries.clear();
+            return false;
+        }
+
+        entries.push_back( e );
+    }
+
+    return true;
+}
+
+void manifest_remove( std::vector< manifest_entry > const & entries, void (*removing)( std::string const & ), void (*error)( std::string const &, int ) )
+{
+    for( std::vector< manifest_entry >::const_iterator i = entries.begin(); i != entries.end(); ++i )
+    {
+        if( i->type != 'f' ) continue;
+
+        if( std::remove( i->path.c_str() ) == 0 )
+        {
+            removing( i->path );
+        }
+        else if( errno != ENOENT )
+        {
+            error( i->path, errno );
+        }
+    }
+
+    // a directory comes before its contents in the archive
+
+    for( std::vector< manifest_entry >::const_reverse_iterator i = entries.rbegin(); i != entries.rend(); ++i )
+    {
+        if( i->type != 'd' ) continue;
+
+        std::string path = i->path;
+        remove_trailing( path, '/' );
+
+        if( fs_rmdir( path ) == 0 )
+        {
+            removing( path );
+        }
+        else if( errno != ENOENT && errno != ENOTEMPTY && errno != EEXIST )
+        {
+            error( path, errno );
+        }
+    }
+}
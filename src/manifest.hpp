@@ -0,0 +1,44 @@
+#ifndef MANIFEST_HPP_INCLUDED
+#define MANIFEST_HPP_INCLUDED
+
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <string>
+#include <vector>
+
+// the manifest of a package, .manifest next to its .installed marker,
+// lists the directories and files extracted from its archive, in the
+// order of the archive, so that they needn't be looked for on disk.
+// It's a text file with a line per entry:
+//
+//   <type> <mode> <mtime> <size> <path>
+//
+// where <type> is 'd' for a directory and 'f' for a file, and <mode>
+// is in octal. The paths of directories end with '/'
+
+struct manifest_entry
+{
+    char type;
+    int mode;
+    long long mtime;
+    long long size;
+    std::string path;
+};
+
+// throws on error
+void manifest_write( std::string const & fn, std::vector< manifest_entry > const & entries );
+
+// returns false when the manifest doesn't exist or is damaged
+bool manifest_read( std::string const & fn, std::vector< manifest_entry > & entries );
+
+// removes the files, and then the directories that have become empty,
+// deepest first; the directories with other contents are left alone
+void manifest_remove( std::vector< manifest_entry > const & entries, void (*removing)( std::string const & ), void (*error)( std::string const &, int ) );
+
+#endif // #ifndef MANIFEST_HPP_INCLUDED
@@ -9,6 +9,7 @@
 #include "message.hpp"
 #include <stdio.h>
 #include <stdarg.h>
+#include <vector>
 
 static int s_level;
 
@@ -36,15 +37,27 @@ void msg_printf( int level, char const * format, ... )
 {
     if( level <= s_level )
     {
-        fprintf( stderr, "bpm: " );
+        // format into a buffer first, so that messages from
+        // different threads are not interleaved
+
+        std::vector< char > buffer( 1024 );
 
         va_list args;
         va_start( args, format );
 
-        vfprintf( stderr, format, args );
+        int r = vsnprintf( &buffer[ 0 ], buffer.size(), format, args );
 
         va_end( args );
 
-        fprintf( stderr, "\n" );
+        if( r >= static_cast< int >( buffer.size() ) )
+        {
+            buffer.resize( r + 1 );
+
+            va_start( args, format );
+            vsnprintf( &buffer[ 0 ], buffer.size(), format, args );
+            va_end( args );
+        }
+
+        fprintf( stderr, "bpm: %s\n", &buffer[ 0 ] );
     }
 }
@@ -0,0 +1,484 @@
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "mirrors.hpp"
+#include "package_path.hpp"
+#include "http_reader.hpp"
+#include "tcp_reader.hpp"
+#include "message.hpp"
+#include "thread.hpp"
+#include <map>
+#include <algorithm>
+#include <exception>
+
+struct mirror
+{
+    std::string path;
+
+    double latency; // seconds, -1 when not known
+    double throughput; // bytes per second, 0 when not known
+
+    int active; // transfers in progress
+    int queued; // reserved by mirror_reserve
+    int failures; // consecutive
+
+    mirror(): latency( -1 ), throughput( 0 ), active( 0 ), queued( 0 ), failures( 0 )
+    {
+    }
+};
+
+class mirror_table;
+
+struct mirror_probe
+{
+    mirror_table * pt;
+    std::size_t index;
+
+    // while waiting for the response, so that it can be cut short
+    tcp_reader * tcp;
+};
+
+// how long mirrors are probed for, at most
+static double const probe_timeout = 3;
+
+class mirror_table
+{
+private:
+
+    mutex mx_;
+    condition cn_;
+
+    bool init_;
+    bool probing_;
+
+    // the remaining probes are abandoned
+    bool probes_stopped_;
+
+    std::vector< mirror > mirrors_;
+
+    std::vector< mirror_probe > probes_;
+    std::size_t probes_done_;
+
+    // mirror index by URL, from mirror_reserve
+    std::map< std::string, std::size_t > reserved_;
+
+private:
+
+    static void probe_proc( void * pv )
+    {
+        mirror_probe * pp = static_cast< mirror_probe* >( pv );
+        pp->pt->probe( pp->index );
+    }
+
+    // time to connect and receive a response header
+    void probe( std::size_t index )
+    {
+        std::string path;
+
+        {
+            scoped_lock lock( mx_ );
+            path = mirrors_[ index ].path;
+        }
+
+        double start = monotonic_clock();
+        double latency = -1;
+
+        try
+        {
+            http_url_parser url( path + "dependencies.txt.lzma" );
+
+            tcp_reader tcp( url.host(), url.port(), probe_timeout );
+
+            std::string rq = "HEAD " + url.request() + " HTTP/1.0\r\nHost: " + url.host() + "\r\n\r\n";
+            tcp.write( rq.data(), rq.size() );
+
+            char buffer[ 12 ]; // HTTP/1.x nnn
+            std::size_t n = 0;
+
+            {
+                scoped_lock lock( mx_ );
+
+                if( !probes_stopped_ )
+                {
+                    probes_[ index ].tcp = &tcp;
+                }
+                else
+                {
+                    tcp.shutdown();
+                }
+            }
+
+            try
+            {
+                while( n < sizeof( buffer ) )
+                {
+                    double timeout = start + probe_timeout - monotonic_clock();
+
+                    if( timeout <= 0 || !tcp.wait( timeout ) ) break;
+
+                    std::size_t r = tcp.read( buffer + n, sizeof( buffer ) - n );
+
+                    if( r == 0 ) break;
+
+                    n += r;
+                }
+            }
+            catch( std::exception const & )
+            {
+            }
+
+            {
+                scoped_lock lock( mx_ );
+                probes_[ index ].tcp = 0;
+            }
+
+            // any response will do, as servers need not implement HEAD
+
+            if( n == sizeof( buffer ) && std::string( buffer, 7 ) == "HTTP/1." )
+            {
+                latency = monotonic_clock() - start;
+            }
+        }
+        catch( std::exception const & )
+        {
+        }
+
+        scoped_lock lock( mx_ );
+
+        mirror & m = mirrors_[ index ];
+
+        if( latency >= 0 )
+        {
+            msg_printf( 2, "mirror '%s' responded in %.0f ms", path.c_str(), latency * 1000 );
+
+            m.latency = latency;
+        }
+        else if( probes_stopped_ || monotonic_clock() - start >= probe_timeout )
+        {
+            // slow rather than failed; its latency stays unknown
+            msg_printf( 1, "mirror '%s' did not respond in time", path.c_str() );
+        }
+        else
+        {
+            msg_printf( 1, "mirror '%s' is not available", path.c_str() );
+
+            ++m.failures;
+        }
+
+        ++probes_done_;
+        cn_.notify_all();
+    }
+
+    void init()
+    {
+        while( probing_ )
+        {
+            cn_.wait( mx_ );
+        }
+
+        if( init_ ) return;
+
+        init_ = true;
+
+        std::vector< std::string > paths = get_package_mirrors();
+
+        if( paths.size() < 2 )
+        {
+            return;
+        }
+
+        mirrors_.resize( paths.size() );
+        probes_.resize( paths.size() );
+
+        for( std::size_t i = 0; i < paths.size(); ++i )
+        {
+            mirrors_[ i ].path = paths[ i ];
+
+            probes_[ i ].pt = this;
+            probes_[ i ].index = i;
+            probes_[ i ].tcp = 0;
+        }
+
+        // probe in parallel, for at most probe_timeout seconds; stop
+        // waiting two seconds after the first response, as the slower
+        // mirrors are ranked last anyway
+
+        probing_ = true;
+
+        std::vector< thread * > threads;
+
+        for( std::size_t i = 0; i < probes_.size(); ++i )
+        {
+            try
+            {
+                threads.push_back( new thread( probe_proc, &probes_[ i ] ) );
+            }
+            catch( std::exception const & )
+            {
+                ++probes_done_;
+            }
+        }
+
+        double deadline = monotonic_clock() + probe_timeout;
+        bool responded = false;
+
+        while( probes_done_ < probes_.size() )
+        {
+            for( std::size_t i = 0; i < mirrors_.size() && !responded; ++i )
+            {
+                if( mirrors_[ i ].latency >= 0 )
+                {
+                    responded = true;
+                    deadline = std::min( deadline, monotonic_clock() + 2 );
+                }
+            }
+
+            double timeout = deadline - monotonic_clock();
+
+            if( timeout <= 0 ) break;
+
+            cn_.wait_for( mx_, timeout );
+        }
+
+        // cut short the probes still waiting for a response, and join
+        // them all; those still connecting give up by the deadline too,
+        // so no probe outlives the table
+
+        probes_stopped_ = true;
+
+        for( std::size_t i = 0; i < probes_.size(); ++i )
+        {
+            if( probes_[ i ].tcp )
+            {
+                probes_[ i ].tcp->shutdown();
+            }
+        }
+
+        mx_.unlock();
+
+        for( std::size_t i = 0; i < threads.size(); ++i )
+        {
+            delete threads[ i ];
+        }
+
+        mx_.lock();
+
+        probing_ = false;
+        cn_.notify_all();
+    }
+
+    // expected cost of a new transfer from mirror 'i'
+    double cost( std::size_t i ) const
+    {
+        mirror const & m = mirrors_[ i ];
+
+        double best_throughput = 0;
+
+        for( std::size_t j = 0; j < mirrors_.size(); ++j )
+        {
+            best_throughput = std::max( best_throughput, mirrors_[ j ].throughput );
+        }
+
+        double latency = m.latency >= 0? m.latency: 1.0;
+
+        double throughput = m.throughput > 0? m.throughput: best_throughput;
+        double transfer = throughput > 0? 1048576 / throughput: 0;
+
+        return ( latency + transfer ) * ( 1 + m.active + m.queued ) + 10.0 * m.failures;
+    }
+
+    std::vector< std::size_t > ranking() const
+    {
+        std::vector< std::pair< double, std::size_t > > v;
+
+        for( std::size_t i = 0; i < mirrors_.size(); ++i )
+        {
+            v.push_back( std::make_pair( cost( i ), i ) );
+        }
+
+        std::stable_sort( v.begin(), v.end() );
+
+        std::vector< std::size_t > r;
+
+        for( std::size_t i = 0; i < v.size(); ++i )
+        {
+            r.push_back( v[ i ].second );
+        }
+
+        return r;
+    }
+
+    // the mirror 'url' is under, or -1; the longest match wins
+    int find( std::string const & url ) const
+    {
+        int r = -1;
+
+        for( std::size_t i = 0; i < mirrors_.size(); ++i )
+        {
+            std::string const & path = mirrors_[ i ].path;
+
+            if( url.compare( 0, path.size(), path ) == 0 && ( r < 0 || path.size() > mirrors_[ r ].path.size() ) )
+            {
+                r = static_cast< int >( i );
+            }
+        }
+
+        return r;
+    }
+
+    bool is_mirrored( std::string const & url ) const
+    {
+        return !mirrors_.empty() && url.compare( 0, mirrors_[ 0 ].path.size(), mirrors_[ 0 ].path ) == 0;
+    }
+
+public:
+
+    mirror_table(): init_( false ), probing_( false ), probes_stopped_( false ), probes_done_( 0 )
+    {
+    }
+
+    std::vector< std::string > urls( std::string const & url )
+    {
+        scoped_lock lock( mx_ );
+
+        init();
+
+        std::vector< std::string > r;
+
+        if( !is_mirrored( url ) )
+        {
+            r.push_back( url );
+            return r;
+        }
+
+        std::string suffix = url.substr( mirrors_[ 0 ].path.size() );
+
+        std::vector< std::size_t > v = ranking();
+
+        std::map< std::string, std::size_t >::iterator i = reserved_.find( url );
+
+        if( i != reserved_.end() )
+        {
+            std::size_t k = i->second;
+
+            --mirrors_[ k ].queued;
+            reserved_.erase( i );
+
+            v.erase( std::remove( v.begin(), v.end(), k ), v.end() );
+            v.insert( v.begin(), k );
+        }
+
+        for( std::size_t j = 0; j < v.size(); ++j )
+        {
+            r.push_back( mirrors_[ v[ j ] ].path + suffix );
+        }
+
+        return r;
+    }
+
+    std::string reserve( std::string const & url )
+    {
+        scoped_lock lock( mx_ );
+
+        init();
+
+        if( !is_mirrored( url ) || reserved_.count( url ) )
+        {
+            return url;
+        }
+
+        std::size_t k = ranking().front();
+
+        ++mirrors_[ k ].queued;
+        reserved_[ url ] = k;
+
+        return mirrors_[ k ].path + url.substr( mirrors_[ 0 ].path.size() );
+    }
+
+    void begin( std::string const & url )
+    {
+        scoped_lock lock( mx_ );
+
+        int i = find( url );
+
+        if( i >= 0 )
+        {
+            ++mirrors_[ i ].active;
+        }
+    }
+
+    void cancel( std::string const & url )
+    {
+        scoped_lock lock( mx_ );
+
+        int i = find( url );
+
+        if( i >= 0 )
+        {
+            --mirrors_[ i ].active;
+        }
+    }
+
+    void end( std::string const & url, bool ok, long long bytes, double seconds )
+    {
+        scoped_lock lock( mx_ );
+
+        int i = find( url );
+
+        if( i < 0 ) return;
+
+        mirror & m = mirrors_[ i ];
+
+        --m.active;
+
+        if( !ok )
+        {
+            ++m.failures;
+            return;
+        }
+
+        m.failures = 0;
+
+        // short transfers measure latency rather than throughput
+
+        if( bytes >= 65536 && seconds > 0 )
+        {
+            double tp = bytes / seconds;
+            m.throughput = m.throughput > 0? 0.7 * m.throughput + 0.3 * tp: tp;
+
+            msg_printf( 2, "mirror '%s': %.0f KB/s", m.path.c_str(), m.throughput / 1024 );
+        }
+    }
+};
+
+static mirror_table s_table;
+
+std::vector< std::string > mirror_urls( std::string const & url )
+{
+    return s_table.urls( url );
+}
+
+std::string mirror_reserve( std::string const & url )
+{
+    return s_table.reserve( url );
+}
+
+void mirror_begin( std::string const & url )
+{
+    s_table.begin( url );
+}
+
+void mirror_end( std::string const & url, bool ok, long long bytes, double seconds )
+{
+    s_table.end( url, ok, bytes, seconds );
+}
+
+void mirror_cancel( std::string const & url )
+{
+    s_table.cancel( url );
+}
@@ -0,0 +1,36 @@
+#ifndef MIRRORS_HPP_INCLUDED
+#define MIRRORS_HPP_INCLUDED
+
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <string>
+#include <vector>
+
+// When package_path lists more than one URL, a URL under the first one
+// can be retrieved from any of them. On first use, the mirrors are
+// probed for latency; afterwards, they are ranked by latency, measured
+// throughput, number of transfers in progress, and recent failures.
+
+// returns the URLs from which 'url' can be retrieved, best first;
+// just 'url' when it isn't under a mirrored package path
+std::vector< std::string > mirror_urls( std::string const & url );
+
+// chooses a mirror for 'url' in advance, for pipelining; the next call to
+// mirror_urls( url ) returns it first. Returns the chosen URL.
+std::string mirror_reserve( std::string const & url );
+
+// to be called around each transfer from a URL returned by mirror_urls
+void mirror_begin( std::string const & url );
+void mirror_end( std::string const & url, bool ok, long long bytes, double seconds );
+
+// ends a transfer that has been abandoned for another one, without
+// counting it as a success or a failure
+void mirror_cancel( std::string const & url );
+
+#endif // #ifndef MIRRORS_HPP_INCLUDED
@@ -0,0 +1,155 @@
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "mmap_reader.hpp"
+#include "error.hpp"
+#include <algorithm>
+#include <cstring>
+
+#if defined( _WIN32 )
+
+#include <windows.h>
+
+mmap_reader::mmap_reader( std::string const & fn ): name_( fn ), handle_( 0 ), data_( 0 ), size_( 0 ), pos_( 0 )
+{
+    HANDLE h = CreateFileA( fn.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0 );
+
+    if( h == INVALID_HANDLE_VALUE )
+    {
+        throw_error( fn, "open error" );
+    }
+
+    LARGE_INTEGER size;
+
+    if( !GetFileSizeEx( h, &size ) )
+    {
+        CloseHandle( h );
+        throw_error( fn, "could not determine file size" );
+    }
+
+    size_ = static_cast< std::size_t >( size.QuadPart );
+
+    if( size_ != 0 )
+    {
+        handle_ = CreateFileMappingA( h, 0, PAGE_READONLY, 0, 0, 0 );
+
+        if( handle_ != 0 )
+        {
+            data_ = static_cast< char const* >( MapViewOfFile( handle_, FILE_MAP_READ, 0, 0, 0 ) );
+        }
+
+        if( data_ == 0 )
+        {
+            if( handle_ ) CloseHandle( handle_ );
+            CloseHandle( h );
+
+            throw_error( fn, "could not map file" );
+        }
+    }
+
+    // the mapping keeps the file open
+    CloseHandle( h );
+}
+
+mmap_reader::~mmap_reader()
+{
+    if( data_ )
+    {
+        UnmapViewOfFile( data_ );
+        CloseHandle( handle_ );
+    }
+}
+
+#else
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+mmap_reader::mmap_reader( std::string const & fn ): name_( fn ), handle_( 0 ), data_( 0 ), size_( 0 ), pos_( 0 )
+{
+    int fd = ::open( fn.c_str(), O_RDONLY );
+
+    if( fd < 0 )
+    {
+        throw_errno_error( fn, "open error", errno );
+    }
+
+    struct stat st;
+
+    if( ::fstat( fd, &st ) != 0 )
+    {
+        int r = errno;
+        ::close( fd );
+
+        throw_errno_error( fn, "stat error", r );
+    }
+
+    size_ = static_cast< std::size_t >( st.st_size );
+
+    if( size_ != 0 )
+    {
+        void * p = ::mmap( 0, size_, PROT_READ, MAP_PRIVATE, fd, 0 );
+
+        if( p == MAP_FAILED )
+        {
+            int r = errno;
+            ::close( fd );
+
+            throw_errno_error( fn, "mmap error", r );
+        }
+
+        ::madvise( p, size_, MADV_SEQUENTIAL );
+
+        data_ = static_cast< char const* >( p );
+    }
+
+    // the mapping keeps the file open
+    ::close( fd );
+}
+
+mmap_reader::~mmap_reader()
+{
+    if( data_ )
+    {
+        ::munmap( const_cast< char* >( data_ ), size_ );
+    }
+}
+
+#endif // defined( _WIN32 )
+
+std::string mmap_reader::name() const
+{
+    return name_;
+}
+
+std::size_t mmap_reader::read( void * p, std::size_t n )
+{
+    n = std::min( n, size_ - pos_ );
+
+    if( n != 0 )
+    {
+        std::memcpy( p, data_ + pos_, n );
+        pos_ += n;
+    }
+
+    return n;
+}
+
+bool mmap_reader::read_direct( void const * & p, std::size_t & n )
+{
+    n = std::min( n, size_ - pos_ );
+
+    p = data_ + pos_;
+    pos_ += n;
+
+    return true;
+}
@@ -0,0 +1,45 @@
+#ifndef MMAP_READER_HPP_INCLUDED
+#define MMAP_READER_HPP_INCLUDED
+
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "basic_reader.hpp"
+
+// reads a file by mapping it into memory, for sequential access; supports
+// read_direct, so that the pages are consumed without being copied
+
+class mmap_reader: public basic_reader
+{
+private:
+
+    std::string name_;
+
+    void * handle_; // the mapping object, on Windows
+    char const * data_;
+    std::size_t size_;
+
+    std::size_t pos_;
+
+private:
+
+    mmap_reader( mmap_reader const & );
+    mmap_reader& operator=( mmap_reader const & );
+
+public:
+
+    explicit mmap_reader( std::string const & fn );
+
+    ~mmap_reader();
+
+    virtual std::string name() const;
+    virtual std::size_t read( void * p, std::size_t n );
+    virtual bool read_direct( void const * & p, std::size_t & n );
+};
+
+#endif // #ifndef MMAP_READER_HPP_INCLUDED
@@ -7,8 +7,10 @@
 //
 
 #include "options.hpp"
+#include <stdexcept>
+#include <cstring>
 
-void parse_options( char const * * & argv, void (*handle_option)( std::string const & opt ) )
+void parse_options( char const * * & argv, void (*handle_option)( std::string const & opt ), char const * with_value )
 {
     while( argv[ 0 ] && ( argv[ 0 ][ 0 ] == '-' || argv[ 0 ][ 0 ] == '+' ) )
     {
@@ -31,6 +33,27 @@ void parse_options( char const * * & argv, void (*handle_option)( std::string co
             for( char const * p = argv[ 0 ] + 1; *p; ++p )
             {
                 char opt[ 3 ] = { argv[ 0 ][ 0 ], *p, 0 };
+
+                if( argv[ 0 ][ 0 ] == '-' && std::strchr( with_value, *p ) )
+                {
+                    // option takes a value, either -jN or -j N; +j is a flag
+
+                    std::string value( p + 1 );
+
+                    if( value.empty() )
+                    {
+                        if( argv[ 1 ] == 0 )
+                        {
+                            throw std::runtime_error( std::string( "option '" ) + opt + "' requires a value" );
+                        }
+
+                        value = *++argv;
+                    }
+
+                    handle_option( opt + value );
+                    break;
+                }
+
                 handle_option( opt );
             }
         }
@@ -11,6 +11,9 @@
 
 #include <string>
 
-void parse_options( char const * * & argv, void (*handle_option)( std::string const & opt ) );
+// '-' options whose letters are listed in 'with_value' take a value, given
+// either as -jN or as -j N; it's passed to handle_option appended to the option
+
+void parse_options( char const * * & argv, void (*handle_option)( std::string const & opt ), char const * with_value = "" );
 
 #endif // #ifndef OPTIONS_HPP_INCLUDED
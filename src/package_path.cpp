@@ -9,15 +9,105 @@
 #include "package_path.hpp"
 #include "config.hpp"
 #include <stdexcept>
+#include <sstream>
 
-std::string get_package_path()
+bool package_path_is_local( std::string const & path )
+{
+    if( path.substr( 0, 7 ) == "file://" )
+    {
+        return true;
+    }
+
+    if( !path.empty() && path[ 0 ] == '/' )
+    {
+        return true;
+    }
+
+#if defined( _WIN32 )
+
+    // C:/x, C:\x, \\server\share
+
+    if( path.size() >= 3 && path[ 1 ] == ':' && ( path[ 2 ] == '/' || path[ 2 ] == '\\' ) )
+    {
+        return true;
+    }
+
+    if( !path.empty() && path[ 0 ] == '\\' )
+    {
+        return true;
+    }
+
+#endif
+
+    return false;
+}
+
+std::string package_file_name( std::string const & url )
 {
-    std::string path = config_get_option( "package_path" );
+    if( url.substr( 0, 7 ) != "file://" )
+    {
+        return url;
+    }
+
+    std::string r = url.substr( 7 );
 
-    if( path.substr( 0, 7 ) != "http://" || *path.rbegin() != '/' )
+    if( r.substr( 0, 9 ) == "localhost" )
     {
-        throw std::runtime_error( "invalid package_path '" + path +  "' in bpm.conf" );
+        r = r.substr( 9 );
     }
 
-    return path;
+#if defined( _WIN32 )
+
+    // file:///C:/x
+
+    if( r.size() >= 3 && r[ 0 ] == '/' && r[ 2 ] == ':' )
+    {
+        r = r.substr( 1 );
+    }
+
+#endif
+
+    return r;
+}
+
+std::vector< std::string > get_package_mirrors()
+{
+    std::string option = config_get_option( "package_path" );
+
+    std::istringstream is( option );
+
+    std::vector< std::string > r;
+
+    std::string path;
+
+    bool local = false;
+
+    while( is >> path )
+    {
+        local = local || package_path_is_local( path );
+
+        if( ( path.substr( 0, 7 ) != "http://" && !package_path_is_local( path ) ) || *path.rbegin() != '/' )
+        {
+            throw std::runtime_error( "invalid package_path '" + path +  "' in bpm.conf" );
+        }
+
+        r.push_back( path );
+    }
+
+    if( r.empty() )
+    {
+        throw std::runtime_error( "invalid package_path '" + option +  "' in bpm.conf" );
+    }
+
+    if( local && r.size() > 1 )
+    {
+        throw std::runtime_error( "a local package_path cannot have mirrors, in bpm.conf" );
+    }
+
+    return r;
+}
+
+std::string get_package_path()
+{
+    return get_package_mirrors().front();
 }
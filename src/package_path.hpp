@@ -10,7 +10,20 @@
 //
 
 #include <string>
+#include <vector>
 
+// the first URL listed in package_path; package URLs are formed from it,
+// and mirrors.hpp maps them to the other URLs, if any
 std::string get_package_path();
 
+// all URLs listed in package_path, separated by spaces
+std::vector< std::string > get_package_mirrors();
+
+// whether 'path' refers to the local file system, as a file:// URL
+// or an absolute path, rather than to an HTTP server
+bool package_path_is_local( std::string const & path );
+
+// the file name for a local package URL, file:///x/y.tar.lzma -> /x/y.tar.lzma
+std::string package_file_name( std::string const & url );
+
 #endif // #ifndef PACKAGE_PATH_HPP_INCLUDED
@@ -0,0 +1,249 @@
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "sha256.hpp"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) ) && ( __GNUC__ >= 5 || defined(__clang__) )
+# define BPM_SHA256_X86
+# include <immintrin.h>
+# include <cpuid.h>
+#endif
+
+static unsigned const s_k[ 64 ] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline unsigned rotr( unsigned x, int n )
+{
+    return ( x >> n ) | ( x << ( 32 - n ) );
+}
+
+// processes n whole 64-byte blocks
+
+static void compress_generic( unsigned state[ 8 ], unsigned char const * p, std::size_t n )
+{
+    for( ; n > 0; --n, p += 64 )
+    {
+        unsigned w[ 64 ];
+
+        for( int i = 0; i < 16; ++i )
+        {
+            w[ i ] = static_cast< unsigned >( p[ 4*i ] ) << 24 | static_cast< unsigned >( p[ 4*i+1 ] ) << 16 | static_cast< unsigned >( p[ 4*i+2 ] ) << 8 | p[ 4*i+3 ];
+        }
+
+        for( int i = 16; i < 64; ++i )
+        {
+            unsigned s0 = rotr( w[ i-15 ], 7 ) ^ rotr( w[ i-15 ], 18 ) ^ ( w[ i-15 ] >> 3 );
+            unsigned s1 = rotr( w[ i-2 ], 17 ) ^ rotr( w[ i-2 ], 19 ) ^ ( w[ i-2 ] >> 10 );
+
+            w[ i ] = w[ i-16 ] + s0 + w[ i-7 ] + s1;
+        }
+
+        unsigned a = state[ 0 ], b = state[ 1 ], c = state[ 2 ], d = state[ 3 ];
+        unsigned e = state[ 4 ], f = state[ 5 ], g = state[ 6 ], h = state[ 7 ];
+
+        for( int i = 0; i < 64; ++i )
+        {
+            unsigned t1 = h + ( rotr( e, 6 ) ^ rotr( e, 11 ) ^ rotr( e, 25 ) ) + ( ( e & f ) ^ ( ~e & g ) ) + s_k[ i ] + w[ i ];
+            unsigned t2 = ( rotr( a, 2 ) ^ rotr( a, 13 ) ^ rotr( a, 22 ) ) + ( ( a & b ) ^ ( a & c ) ^ ( b & c ) );
+
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[ 0 ] += a; state[ 1 ] += b; state[ 2 ] += c; state[ 3 ] += d;
+        state[ 4 ] += e; state[ 5 ] += f; state[ 6 ] += g; state[ 7 ] += h;
+    }
+}
+
+typedef void compress_fn( unsigned state[ 8 ], unsigned char const * p, std::size_t n );
+
+#if defined( BPM_SHA256_X86 )
+
+// four rounds at a time with SHA256RNDS2, keeping the state as ABEF and
+// CDGH, and the message schedule with SHA256MSG1/SHA256MSG2
+
+__attribute__(( target( "sha,sse4.1" ) ))
+static void compress_shani( unsigned state[ 8 ], unsigned char const * p, std::size_t n )
+{
+    __m128i const mask = _mm_set_epi64x( 0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL );
+
+    __m128i t = _mm_loadu_si128( (__m128i const*)&state[ 0 ] ); // DCBA
+    __m128i s1 = _mm_loadu_si128( (__m128i const*)&state[ 4 ] ); // HGFE
+
+    t = _mm_shuffle_epi32( t, 0xB1 ); // CDAB
+    s1 = _mm_shuffle_epi32( s1, 0x1B ); // EFGH
+
+    __m128i s0 = _mm_alignr_epi8( t, s1, 8 ); // ABEF
+    s1 = _mm_blend_epi16( s1, t, 0xF0 ); // CDGH
+
+    for( ; n > 0; --n, p += 64 )
+    {
+        __m128i const abef = s0;
+        __m128i const cdgh = s1;
+
+        __m128i w[ 4 ];
+
+        for( int i = 0; i < 16; ++i )
+        {
+            if( i < 4 )
+            {
+                w[ i ] = _mm_shuffle_epi8( _mm_loadu_si128( (__m128i const*)( p + 16 * i ) ), mask );
+            }
+            else
+            {
+                __m128i x = _mm_sha256msg1_epu32( w[ i & 3 ], w[ ( i + 1 ) & 3 ] );
+                x = _mm_add_epi32( x, _mm_alignr_epi8( w[ ( i + 3 ) & 3 ], w[ ( i + 2 ) & 3 ], 4 ) );
+                w[ i & 3 ] = _mm_sha256msg2_epu32( x, w[ ( i + 3 ) & 3 ] );
+            }
+
+            __m128i m = _mm_add_epi32( w[ i & 3 ], _mm_loadu_si128( (__m128i const*)( s_k + 4 * i ) ) );
+
+            s1 = _mm_sha256rnds2_epu32( s1, s0, m );
+            s0 = _mm_sha256rnds2_epu32( s0, s1, _mm_shuffle_epi32( m, 0x0E ) );
+        }
+
+        s0 = _mm_add_epi32( s0, abef );
+        s1 = _mm_add_epi32( s1, cdgh );
+    }
+
+    t = _mm_shuffle_epi32( s0, 0x1B ); // FEBA
+    s1 = _mm_shuffle_epi32( s1, 0xB1 ); // DCHG
+
+    _mm_storeu_si128( (__m128i*)&state[ 0 ], _mm_blend_epi16( t, s1, 0xF0 ) ); // DCBA
+    _mm_storeu_si128( (__m128i*)&state[ 4 ], _mm_alignr_epi8( s1, t, 8 ) ); // HGFE
+}
+
+static bool has_shani()
+{
+    unsigned a, b, c, d;
+
+    // SSSE3 and SSE4.1, then SHA
+
+    if( !__get_cpuid( 1, &a, &b, &c, &d ) || ( c & ( 1u << 9 ) ) == 0 || ( c & ( 1u << 19 ) ) == 0 )
+    {
+        return false;
+    }
+
+    if( __get_cpuid_max( 0, 0 ) < 7 )
+    {
+        return false;
+    }
+
+    __cpuid_count( 7, 0, a, b, c, d );
+
+    return ( b & ( 1u << 29 ) ) != 0;
+}
+
+static compress_fn * const s_compress = has_shani()? compress_shani: compress_generic;
+
+#else
+
+static compress_fn * const s_compress = compress_generic;
+
+#endif
+
+sha256::sha256(): n_( 0 ), size_( 0 )
+{
+    static unsigned const h0[ 8 ] =
+    {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    std::memcpy( state_, h0, sizeof( state_ ) );
+}
+
+void sha256::update( void const * p, std::size_t n )
+{
+    unsigned char const * p2 = static_cast< unsigned char const* >( p );
+
+    size_ += n;
+
+    if( n_ > 0 )
+    {
+        std::size_t k = std::min( n, 64 - n_ );
+
+        std::memcpy( block_ + n_, p2, k );
+
+        n_ += k;
+        p2 += k;
+        n -= k;
+
+        if( n_ < 64 )
+        {
+            return;
+        }
+
+        s_compress( state_, block_, 1 );
+        n_ = 0;
+    }
+
+    // whole blocks directly from the input
+
+    s_compress( state_, p2, n / 64 );
+
+    p2 += n / 64 * 64;
+    n %= 64;
+
+    std::memcpy( block_, p2, n );
+    n_ = n;
+}
+
+std::string sha256::hex_digest() const
+{
+    unsigned state[ 8 ];
+    std::memcpy( state, state_, sizeof( state ) );
+
+    // the padding: 0x80, zeros, and the size in bits, big endian
+
+    unsigned char block[ 128 ] = { 0 };
+
+    std::memcpy( block, block_, n_ );
+    block[ n_ ] = 0x80;
+
+    std::size_t m = n_ + 9 <= 64? 64: 128;
+
+    unsigned long long bits = size_ * 8;
+
+    for( int i = 0; i < 8; ++i )
+    {
+        block[ m - 1 - i ] = static_cast< unsigned char >( bits >> ( 8 * i ) );
+    }
+
+    s_compress( state, block, m / 64 );
+
+    char const * const hex = "0123456789abcdef";
+
+    std::string r;
+
+    for( int i = 0; i < 8; ++i )
+    {
+        for( int j = 28; j >= 0; j -= 4 )
+        {
+            r += hex[ ( state[ i ] >> j ) & 0xF ];
+        }
+    }
+
+    return r;
+}
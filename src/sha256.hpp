@@ -0,0 +1,38 @@
+#ifndef SHA256_HPP_INCLUDED
+#define SHA256_HPP_INCLUDED
+
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <string>
+#include <cstddef>
+
+// SHA-256; uses the SHA extensions of x86 processors that have them
+
+class sha256
+{
+private:
+
+    unsigned state_[ 8 ];
+
+    unsigned char block_[ 64 ];
+    std::size_t n_; // in block_
+
+    unsigned long long size_;
+
+public:
+
+    sha256();
+
+    void update( void const * p, std::size_t n );
+
+    // returns the digest of the data so far, in lowercase hex
+    std::string hex_digest() const;
+};
+
+#endif // #ifndef SHA256_HPP_INCLUDED
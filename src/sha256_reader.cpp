@@ -0,0 +1,61 @@
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "sha256_reader.hpp"
+
+sha256_reader::sha256_reader( basic_reader * pr ): pr_( pr )
+{
+}
+
+std::string sha256_reader::name() const
+{
+    return pr_->name();
+}
+
+std::size_t sha256_reader::read( void * p, std::size_t n )
+{
+    std::size_t r = pr_->read( p, n );
+
+    hash_.update( p, r );
+
+    return r;
+}
+
+bool sha256_reader::read_direct( void const * & p, std::size_t & n )
+{
+    if( !pr_->read_direct( p, n ) )
+    {
+        return false;
+    }
+
+    hash_.update( p, n );
+
+    return true;
+}
+
+std::string sha256_reader::hex_digest()
+{
+    for( ;; )
+    {
+        void const * p = 0;
+        std::size_t n = 65536;
+
+        if( read_direct( p, n ) )
+        {
+            if( n == 0 ) break;
+        }
+        else
+        {
+            char buffer[ 4096 ];
+
+            if( read( buffer, sizeof( buffer ) ) == 0 ) break;
+        }
+    }
+
+    return hash_.hex_digest();
+}
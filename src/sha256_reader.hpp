@@ -0,0 +1,42 @@
+#ifndef SHA256_READER_HPP_INCLUDED
+#define SHA256_READER_HPP_INCLUDED
+
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "basic_reader.hpp"
+#include "sha256.hpp"
+
+// passes the data read from 'pr' through, computing its SHA-256 digest
+// on the way
+
+class sha256_reader: public basic_reader
+{
+private:
+
+    basic_reader * pr_;
+    sha256 hash_;
+
+private:
+
+    sha256_reader( sha256_reader const & );
+    sha256_reader& operator=( sha256_reader const & );
+
+public:
+
+    explicit sha256_reader( basic_reader * pr );
+
+    virtual std::string name() const;
+    virtual std::size_t read( void * p, std::size_t n );
+    virtual bool read_direct( void const * & p, std::size_t & n );
+
+    // reads the rest of the input, and returns the digest of all of it
+    std::string hex_digest();
+};
+
+#endif // #ifndef SHA256_READER_HPP_INCLUDED
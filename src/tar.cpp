@@ -10,6 +10,10 @@
 #include "error.hpp"
 #include "fs.hpp"
 #include "message.hpp"
+#include "thread.hpp"
+#include <algorithm>
+#include <vector>
+#include <map>
 #include <cstdio>
 #include <cstddef>
 #include <cassert>
@@ -127,6 +131,335 @@ static bool read_header( basic_reader * pr, char (&header)[ N ], std::string & f
     return false;
 }
 
+// reads at most 'n' bytes, in place when the reader supports it, and
+// otherwise into 'buffer', of 'size' bytes; returns the number of bytes,
+// 0 at EOF
+
+static std::size_t read_span( basic_reader * pr, char * buffer, std::size_t size, char const * & p, std::size_t n )
+{
+    void const * p2 = 0;
+    std::size_t n2 = n;
+
+    if( pr->read_direct( p2, n2 ) )
+    {
+        p = static_cast< char const* >( p2 );
+        return n2;
+    }
+
+    p = buffer;
+    return pr->read( buffer, std::min( n, size ) );
+}
+
+// the directory of the last entry, kept open, as the entries of an
+// archive come grouped by directory; the others are created in it by
+// name, with fs_creat_at and fs_mkdir_at
+
+class parent_directory
+{
+private:
+
+    std::string path_;
+    int dir_;
+    bool valid_;
+
+private:
+
+    parent_directory( parent_directory const & );
+    parent_directory& operator=( parent_directory const & );
+
+public:
+
+    parent_directory(): dir_( -1 ), valid_( false )
+    {
+    }
+
+    ~parent_directory()
+    {
+        if( dir_ >= 0 )
+        {
+            fs_close_dir( dir_ );
+        }
+    }
+
+    // returns the directory of 'fn', -1 if it couldn't be opened, and
+    // the name of 'fn' in it; a trailing '/' is part of the name
+
+    int get( std::string const & fn, std::string & name )
+    {
+        std::size_t i = fn.size() < 2? std::string::npos: fn.rfind( '/', fn.size() - 2 );
+        std::size_t n = i == std::string::npos? 0: i + 1;
+
+        name = fn.substr( n );
+
+        if( !valid_ || path_.compare( 0, std::string::npos, fn, 0, n ) != 0 )
+        {
+            if( dir_ >= 0 )
+            {
+                fs_close_dir( dir_ );
+            }
+
+            path_ = fn.substr( 0, n );
+            dir_ = fs_open_dir( path_ );
+            valid_ = true;
+        }
+
+        return dir_;
+    }
+};
+
+// writes a file whose contents are in memory
+
+static void write_file( parent_directory & parent, std::string const & fn, char const * p, std::size_t size, long long mtime )
+{
+    std::string name;
+    int dir = parent.get( fn, name );
+
+    int fd = fs_creat_at( dir, name, fn, 0644 );
+
+    if( fd < 0 )
+    {
+        throw_errno_error( fn, "create error", errno );
+    }
+
+    if( size > 65536 && fs_allocate( fd, size ) != 0 )
+    {
+        int r2 = errno;
+
+        fs_close( fd );
+        throw_errno_error( fn, "write error", r2 );
+    }
+
+    if( size != 0 )
+    {
+        int r = fs_write( fd, p, static_cast< unsigned >( size ) );
+
+        if( r < 0 )
+        {
+            int r2 = errno;
+
+            fs_close( fd );
+            throw_errno_error( fn, "write error", r2 );
+        }
+
+        if( static_cast< std::size_t >( r ) != size )
+        {
+            fs_close( fd );
+            throw_errno_error( fn, "write error", ENOSPC );
+        }
+    }
+
+    fs_futime( fd, mtime, std::time( 0 ) );
+    fs_close( fd );
+}
+
+// pipelined extraction: the decoding thread parses the archive and
+// creates the directories itself, so that each exists before anything
+// is created in it, and passes the smaller files, with their contents,
+// through a ring of slots to a pool of writer threads. The larger files
+// it writes itself, from the decoded data in place
+
+struct tar_slot
+{
+    enum state_type { idle, queued, writing };
+
+    state_type state;
+
+    std::string fn;
+    long long mtime;
+
+    // the contents; the capacity is kept for the next file
+    std::vector< char > data;
+
+    tar_slot(): state( idle ), mtime( 0 )
+    {
+    }
+};
+
+class tar_writers
+{
+public:
+
+    // files larger than this are written by the decoding thread
+    static std::size_t const max_size = 1048576;
+
+private:
+
+    std::vector< tar_slot > slots_;
+
+    std::size_t head_; // the next slot to be written
+    std::size_t tail_; // the next slot to be filled
+
+    std::vector< thread * > threads_;
+    bool stop_;
+
+    // the first error of a writer; the other files are then skipped
+    bool failed_;
+    std::string error_name_;
+    std::string error_reason_;
+
+    mutex mx_;
+    condition cn_;
+
+private:
+
+    tar_writers( tar_writers const & );
+    tar_writers& operator=( tar_writers const & );
+
+    static void thread_proc( void * pv )
+    {
+        static_cast< tar_writers* >( pv )->work();
+    }
+
+    void work()
+    {
+        parent_directory parent;
+
+        scoped_lock lock( mx_ );
+
+        for( ;; )
+        {
+            while( slots_[ head_ % slots_.size() ].state != tar_slot::queued && !stop_ )
+            {
+                cn_.wait( mx_ );
+            }
+
+            if( stop_ ) return;
+
+            tar_slot & s = slots_[ head_++ % slots_.size() ];
+            s.state = tar_slot::writing;
+
+            if( !failed_ )
+            {
+                std::string name, reason;
+
+                mx_.unlock();
+
+                try
+                {
+                    write_file( parent, s.fn, s.data.empty()? 0: &s.data[ 0 ], s.data.size(), s.mtime );
+                }
+                catch( error const & x )
+                {
+                    name = x.name();
+                    reason = x.reason();
+                }
+                catch( std::exception const & x )
+                {
+                    name = s.fn;
+                    reason = x.what();
+                }
+
+                mx_.lock();
+
+                if( !reason.empty() && !failed_ )
+                {
+                    failed_ = true;
+                    error_name_ = name;
+                    error_reason_ = reason;
+                }
+            }
+
+            s.state = tar_slot::idle;
+            cn_.notify_all();
+        }
+    }
+
+    void throw_if_failed()
+    {
+        if( failed_ )
+        {
+            throw_error( error_name_, error_reason_ );
+        }
+    }
+
+public:
+
+    // starts up to 'n' threads, none when 'n' is 0; the ring has four
+    // slots per thread
+    explicit tar_writers( unsigned n ): slots_( 4 * n ), head_( 0 ), tail_( 0 ), stop_( false ), failed_( false )
+    {
+        for( unsigned i = 0; i < n; ++i )
+        {
+            try
+            {
+                threads_.push_back( new thread( thread_proc, this ) );
+            }
+            catch( std::exception const & )
+            {
+                break;
+            }
+        }
+    }
+
+    // stops the threads; the files not yet written are abandoned
+    ~tar_writers()
+    {
+        {
+            scoped_lock lock( mx_ );
+
+            stop_ = true;
+            cn_.notify_all();
+        }
+
+        for( std::vector< thread * >::iterator i = threads_.begin(); i != threads_.end(); ++i )
+        {
+            delete *i; // joins
+        }
+    }
+
+    // true when no thread could be started
+    bool empty() const
+    {
+        return threads_.empty();
+    }
+
+    // waits for the next slot to become free; throws the error of a writer
+    tar_slot & acquire()
+    {
+        scoped_lock lock( mx_ );
+
+        while( slots_[ tail_ % slots_.size() ].state != tar_slot::idle && !failed_ )
+        {
+            cn_.wait( mx_ );
+        }
+
+        throw_if_failed();
+
+        return slots_[ tail_ % slots_.size() ];
+    }
+
+    // queues the slot returned by acquire, once it has been filled
+    void push()
+    {
+        scoped_lock lock( mx_ );
+
+        slots_[ tail_++ % slots_.size() ].state = tar_slot::queued;
+        cn_.notify_all();
+    }
+
+    // waits until the queued files have been written; throws the error of a writer
+    void finish()
+    {
+        scoped_lock lock( mx_ );
+
+        for( ;; )
+        {
+            bool done = true;
+
+            for( std::size_t i = 0; i < slots_.size(); ++i )
+            {
+                done = done && slots_[ i ].state == tar_slot::idle;
+            }
+
+            if( done || failed_ ) break;
+
+            cn_.wait( mx_ );
+        }
+
+        throw_if_failed();
+    }
+};
+
 static void read_long_name( basic_reader * pr, long long size, std::string & fn )
 {
     fn.clear();
@@ -166,24 +499,55 @@ static void read_long_name( basic_reader * pr, long long size, std::string & fn
     }
 }
 
-void tar_extract( basic_reader * pr, std::string const & prefix, std::set< std::string > const & whitelist )
+tar_reader::tar_reader( basic_reader * pr ): pr_( pr ), remaining_( 0 ), padding_( 0 )
 {
-    msg_printf( 1, "extracting from '%s'", pr->name().c_str() );
+}
 
-    for( ;; )
+std::string tar_reader::name() const
+{
+    return pr_->name();
+}
+
+// skips 'n' bytes of input
+void tar_reader::skip( long long n )
+{
+    while( n > 0 )
     {
-        char header[ N ];
+        void const * p = 0;
+        std::size_t k = static_cast< std::size_t >( std::min< long long >( n, 1 << 30 ) );
+
+        if( !pr_->read_direct( p, k ) )
+        {
+            if( buffer_.empty() )
+            {
+                buffer_.resize( 65536 );
+            }
+
+            k = pr_->read( &buffer_[ 0 ], static_cast< std::size_t >( std::min< long long >( n, buffer_.size() ) ) );
+        }
+
+        if( k == 0 )
+        {
+            throw_eof_error( pr_->name() );
+        }
+
+        n -= k;
+    }
+}
+
+bool tar_reader::next( tar_entry & e )
+{
+    skip( remaining_ + padding_ );
 
-        std::string fn;
+    remaining_ = padding_ = 0;
 
-        char type = 0;
-        long long size = 0;
-        int mode = 0;
-        long long mtime = 0;
+    for( ;; )
+    {
+        char header[ N ];
 
-        if( read_header( pr, header, fn, type, size, mode, mtime ) )
+        if( read_header( pr_, header, e.path, e.type, e.size, e.mode, e.mtime ) )
         {
-            break; // EOF
+            return false; // EOF
         }
 
         if( header[ 0 ] == 0 )
@@ -191,40 +555,327 @@ void tar_extract( basic_reader * pr, std::string const & prefix, std::set< std::
             continue;
         }
 
-        if( type == 'L' )
+        if( e.type == 'L' )
         {
             // GNU long name extension
 
-            read_long_name( pr, size, fn );
+            std::string fn;
+            read_long_name( pr_, e.size, fn );
 
-            std::string fn2;
-
-            if( read_header( pr, header, fn2, type, size, mode, mtime ) )
+            if( read_header( pr_, header, e.path, e.type, e.size, e.mode, e.mtime ) )
             {
-                throw_eof_error( pr->name() );
+                throw_eof_error( pr_->name() );
             }
+
+            e.path = fn;
+        }
+
+        remaining_ = e.size;
+        padding_ = ( N - e.size % N ) % N;
+
+        return true;
+    }
+}
+
+std::size_t tar_reader::read( void * p, std::size_t n )
+{
+    n = static_cast< std::size_t >( std::min< long long >( n, remaining_ ) );
+
+    if( n != 0 && pr_->read( p, n ) != n )
+    {
+        throw_eof_error( pr_->name() );
+    }
+
+    remaining_ -= n;
+    return n;
+}
+
+bool tar_reader::read_direct( void const * & p, std::size_t & n )
+{
+    if( remaining_ == 0 )
+    {
+        n = 0;
+        return true;
+    }
+
+    std::size_t k = static_cast< std::size_t >( std::min< long long >( n, remaining_ ) );
+
+    if( !pr_->read_direct( p, k ) )
+    {
+        return false;
+    }
+
+    if( k == 0 )
+    {
+        throw_eof_error( pr_->name() );
+    }
+
+    remaining_ -= k;
+    n = k;
+
+    return true;
+}
+
+// reads the 'size' bytes of data of the current entry into 'p'
+static void read_data( tar_reader & tr, char * p, std::size_t size )
+{
+    if( size != 0 )
+    {
+        tr.read( p, size );
+    }
+}
+
+// whether 'fn' is to be extracted when only the 'subtrees' of the
+// package directory 'prefix', and of its sub-libraries, are. The files
+// at the top of the package, sublibs, which cmd_headers looks for, and
+// meta/, which cmd_index reads, always are, and so is everything
+// outside 'prefix', which is whitelisted. When that depends on whether
+// the first-level directory of 'fn' is a sub-library, 'lib' is set to
+// it; otherwise, it's cleared
+
+static bool is_selected( std::string const & fn, std::string const & prefix, std::set< std::string > const & subtrees, std::string & lib )
+{
+    lib.clear();
+
+    if( subtrees.empty() || fn.compare( 0, prefix.size(), prefix ) != 0 ) return true;
+
+    std::size_t i = fn.find( '/', prefix.size() );
+
+    if( i == std::string::npos ) return true; // the directory itself, or a file at the top
+
+    std::string c0 = fn.substr( prefix.size(), i - prefix.size() );
+
+    if( c0 == "meta" || c0 == "sublibs" || subtrees.count( c0 ) ) return true;
+
+    std::size_t j = fn.find( '/', i + 1 );
+
+    if( j == std::string::npos ) return false;
+
+    std::string c1 = fn.substr( i + 1, j - i - 1 );
+
+    if( c1 == "meta" || subtrees.count( c1 ) )
+    {
+        lib = fn.substr( 0, i + 1 );
+        return true;
+    }
+
+    return false;
+}
+
+// a first-level directory of the package is a sub-library when the
+// package has sublibs and the directory has include/ or meta/, as for
+// cmd_headers and cmd_index; notes what 'fn' tells about that
+
+static void note_library( std::string const & fn, std::string const & prefix, bool & sublibs, std::set< std::string > & libs )
+{
+    if( fn.compare( 0, prefix.size(), prefix ) != 0 ) return;
+
+    std::size_t const n = prefix.size() + 7;
+
+    if( fn.compare( prefix.size(), 7, "sublibs" ) == 0 && ( fn.size() == n || fn[ n ] == '/' ) )
+    {
+        sublibs = true;
+        return;
+    }
+
+    std::size_t i = fn.find( '/', prefix.size() );
+
+    if( i == std::string::npos ) return;
+
+    std::size_t j = fn.find( '/', i + 1 );
+
+    if( j == std::string::npos ) return;
+
+    std::string c1 = fn.substr( i + 1, j - i - 1 );
+
+    if( c1 == "include" || c1 == "meta" )
+    {
+        libs.insert( fn.substr( 0, i + 1 ) );
+    }
+}
+
+static void removing_unselected( std::string const & path )
+{
+    msg_printf( 2, "removing '%s'", path.c_str() );
+}
+
+static void remove_error( std::string const & path, int err )
+{
+    throw_errno_error( path, "remove error", err );
+}
+
+// removes what has been extracted, from manifest[ first ] on, from the
+// directories in 'tentative' that have turned out not to be sub-libraries
+
+static void remove_unselected( std::set< std::string > const & tentative, bool sublibs, std::set< std::string > const & libs, std::size_t first, std::vector< manifest_entry > & manifest )
+{
+    std::set< std::string > unselected;
+
+    for( std::set< std::string >::const_iterator i = tentative.begin(); i != tentative.end(); ++i )
+    {
+        if( !sublibs || libs.count( *i ) == 0 )
+        {
+            unselected.insert( *i );
+        }
+    }
+
+    if( unselected.empty() ) return;
+
+    std::vector< manifest_entry > kept( manifest.begin(), manifest.begin() + first );
+    std::vector< manifest_entry > removed;
+
+    for( std::size_t k = first; k < manifest.size(); ++k )
+    {
+        manifest_entry const & e = manifest[ k ];
+
+        // the directory that would contain e.path is the last one before it
+
+        std::set< std::string >::const_iterator i = unselected.upper_bound( e.path );
+
+        bool in = false;
+
+        if( i != unselected.begin() )
+        {
+            --i;
+            in = e.path.compare( 0, i->size(), *i ) == 0;
+        }
+
+        if( in )
+        {
+            removed.push_back( e );
+        }
+        else
+        {
+            kept.push_back( e );
+        }
+    }
+
+    manifest_remove( removed, removing_unselected, remove_error );
+
+    manifest.swap( kept );
+}
+
+// creates the directories above 'fn' that have been skipped, in 'skipped',
+// with their mtimes, as something has been selected in them after all
+
+static void create_skipped_directories( std::string const & fn, std::map< std::string, long long > & skipped, std::vector< manifest_entry > & manifest )
+{
+    for( std::size_t i = fn.find( '/' ); i != std::string::npos && i + 1 < fn.size(); i = fn.find( '/', i + 1 ) )
+    {
+        std::map< std::string, long long >::iterator j = skipped.find( fn.substr( 0, i + 1 ) );
+
+        if( j == skipped.end() ) continue;
+
+        std::string const & dir = j->first;
+
+        msg_printf( 2, "extracting '%s'", dir.c_str() );
+
+        manifest_entry e = { 'd', 0755, j->second, 0, dir };
+        manifest.push_back( e );
+
+        if( fs_mkdir( dir, 0755 ) < 0 )
+        {
+            throw_errno_error( dir, "create error", errno );
         }
 
+        fs_utime( dir, j->second, std::time( 0 ) );
+
+        skipped.erase( j );
+    }
+}
+
+// the smaller files are written by 'pool', when it has threads
+
+static void extract( tar_reader & tr, std::string const & prefix, std::set< std::string > const & whitelist, std::set< std::string > const & subtrees, tar_writers & pool, std::vector< manifest_entry > & manifest )
+{
+    msg_printf( 1, "extracting from '%s'", tr.name().c_str() );
+
+    // for readers without read_direct
+    std::vector< char > buffer( 65536 );
+
+    parent_directory parent;
+
+    // the directories not selected by 'subtrees'
+    std::map< std::string, long long > skipped;
+
+    // whether the package has sublibs, and its first-level directories
+    // with include/ or meta/
+    bool sublibs = false;
+    std::set< std::string > libs;
+
+    // the first-level directories from which something is extracted
+    // only because they may be sub-libraries; the archive is in no
+    // particular order, so this is known only at its end
+    std::set< std::string > tentative;
+
+    std::size_t const first = manifest.size();
+
+    tar_entry e;
+
+    while( tr.next( e ) )
+    {
+        std::string const & fn = e.path;
+
+        char type = e.type;
+        long long size = e.size;
+        long long mtime = e.mtime;
+
         if( ( fn.substr( 0, prefix.size() ) != prefix && whitelist.count( fn ) == 0 ) || contains_dotdot( fn ) )
         {
-            throw_error( pr->name(), "disallowed file name: '" + fn + "'" );
+            throw_error( tr.name(), "disallowed file name: '" + fn + "'" );
         }
 
         if( type != 0 && type != '0' && type != '5' )
         {
-            throw_error( pr->name(), "disallowed file type" );
+            throw_error( tr.name(), "disallowed file type" );
         }
 
-        msg_printf( 2, "extracting '%s'", fn.c_str() );
+        if( type == '5' && size != 0 )
+        {
+            throw_error( tr.name(), "directory with nonzero size: '" + fn + "'" );
+        }
 
-        if( type == '5' ) // directory
+        note_library( fn, prefix, sublibs, libs );
+
+        std::string lib;
+
+        if( !is_selected( fn, prefix, subtrees, lib ) )
         {
-            if( size != 0 )
+            // the data is skipped by next()
+
+            msg_printf( 2, "skipping '%s'", fn.c_str() );
+
+            if( type == '5' )
             {
-                throw_error( pr->name(), "directory with nonzero size: '" + fn + "'" );
+                skipped[ fn ] = mtime;
             }
 
-            int r = fs_mkdir( fn, 0755 );
+            continue;
+        }
+
+        if( !lib.empty() )
+        {
+            tentative.insert( lib );
+        }
+
+        if( !skipped.empty() )
+        {
+            create_skipped_directories( fn, skipped, manifest );
+        }
+
+        msg_printf( 2, "extracting '%s'", fn.c_str() );
+
+        {
+            manifest_entry e2 = { type == '5'? 'd': 'f', type == '5'? 0755: 0644, mtime, size, fn };
+            manifest.push_back( e2 );
+        }
+
+        std::string name;
+        int dir = parent.get( fn, name );
+
+        if( type == '5' ) // directory
+        {
+            int r = fs_mkdir_at( dir, name, fn, 0755 );
 
             if( r < 0 )
             {
@@ -236,45 +887,57 @@ void tar_extract( basic_reader * pr, std::string const & prefix, std::set< std::
                 fs_utime( fn, mtime, std::time( 0 ) );
             }
         }
+        else if( !pool.empty() && size <= static_cast< long long >( tar_writers::max_size ) )
+        {
+            tar_slot & s = pool.acquire();
+
+            s.fn = fn;
+            s.mtime = mtime;
+            s.data.resize( static_cast< std::size_t >( size ) );
+
+            read_data( tr, s.data.empty()? 0: &s.data[ 0 ], s.data.size() );
+
+            pool.push();
+        }
         else // regular file
         {
-            int fd = fs_creat( fn, 0644 );
+            int fd = fs_creat_at( dir, name, fn, 0644 );
 
             if( fd < 0 )
             {
                 throw_errno_error( fn, "create error", errno );
             }
 
-            long long k = 0;
+            // files that will likely take more than one write are
+            // allocated at once, so that they aren't fragmented
 
-            while( k < size )
+            if( size > static_cast< long long >( buffer.size() ) && fs_allocate( fd, size ) != 0 )
             {
-                char data[ N ];
+                int r2 = errno;
 
-                {
-                    std::size_t r = pr->read( data, N );
+                fs_close( fd );
+                throw_errno_error( fn, "write error", r2 );
+            }
 
-                    if( r < N )
-                    {
-                        throw_eof_error( pr->name() );
-                    }
-                }
+            long long k = 0;
+
+            while( k < size )
+            {
+                char const * p = 0;
 
-                unsigned m;
+                std::size_t n;
 
-                if( k + N <= size )
+                try
                 {
-                    m = N;
+                    n = read_span( &tr, &buffer[ 0 ], buffer.size(), p, static_cast< std::size_t >( std::min< long long >( size - k, 1 << 30 ) ) );
                 }
-                else
+                catch( std::exception const & )
                 {
-                    assert( size - k <= UINT_MAX );
-                    assert( size - k <= N );
-
-                    m = static_cast< unsigned >( size - k );
+                    fs_close( fd );
+                    throw;
                 }
 
-                int r = fs_write( fd, data, m );
+                int r = fs_write( fd, p, static_cast< unsigned >( n ) );
 
                 if( r < 0 )
                 {
@@ -284,17 +947,34 @@ void tar_extract( basic_reader * pr, std::string const & prefix, std::set< std::
                     throw_errno_error( fn, "write error", r2 );
                 }
 
-                if( static_cast< unsigned >( r ) != m )
+                if( static_cast< std::size_t >( r ) != n )
                 {
                     fs_close( fd );
                     throw_errno_error( fn, "write error", ENOSPC );
                 }
 
-                k += N;
+                k += n;
             }
 
+            fs_futime( fd, mtime, std::time( 0 ) );
             fs_close( fd );
-            fs_utime( fn, mtime, std::time( 0 ) );
         }
     }
+
+    pool.finish();
+
+    if( !tentative.empty() )
+    {
+        remove_unselected( tentative, sublibs, libs, first, manifest );
+    }
+}
+
+void tar_extract( basic_reader * pr, std::string const & prefix, std::set< std::string > const & whitelist, std::set< std::string > const & subtrees, unsigned writers, std::vector< manifest_entry > & manifest )
+{
+    tar_reader tr( pr );
+
+    // when no thread can be started, the files are written by extract
+    tar_writers pool( writers );
+
+    extract( tr, prefix, whitelist, subtrees, pool, manifest );
 }
@@ -10,9 +10,65 @@
 //
 
 #include "basic_reader.hpp"
+#include "manifest.hpp"
 #include <string>
+#include <vector>
 #include <set>
 
-void tar_extract( basic_reader * pr, std::string const & prefix, std::set< std::string > const & whitelist );
+struct tar_entry
+{
+    std::string path;
+    char type; // '0' (or 0) for a file, '5' for a directory
+    long long size;
+    int mode;
+    long long mtime;
+};
+
+// reads the entries of a tar archive one at a time: next() moves to the
+// following entry, and the tar_reader itself reads the data of the
+// current one. Data that hasn't been read is skipped by next(), in place
+// when 'pr' supports read_direct, so unneeded entries cost no copy
+
+class tar_reader: public basic_reader
+{
+private:
+
+    basic_reader * pr_;
+
+    long long remaining_; // the data of the current entry not yet read
+    long long padding_; // to a whole number of blocks, after the data
+
+    // for skipping, when 'pr' doesn't support read_direct
+    std::vector< char > buffer_;
+
+private:
+
+    tar_reader( tar_reader const & );
+    tar_reader& operator=( tar_reader const & );
+
+    void skip( long long n );
+
+public:
+
+    explicit tar_reader( basic_reader * pr );
+
+    // returns false at the end of the archive
+    bool next( tar_entry & e );
+
+    virtual std::string name() const;
+    virtual std::size_t read( void * p, std::size_t n );
+    virtual bool read_direct( void const * & p, std::size_t & n );
+};
+
+// extracts the archive; when 'subtrees' isn't empty, only the listed
+// subdirectories of the package directory 'prefix', and of its
+// sub-libraries, are, along with the files at its top, sublibs and
+// meta/; a sub-library is a first-level directory with include/ or
+// meta/ in a package with sublibs. With 'writers' > 0, files are
+// written by that many threads while the archive is being decoded.
+// Each entry is appended to 'manifest' before it's created, so that on
+// error 'manifest' lists everything that may have been created
+
+void tar_extract( basic_reader * pr, std::string const & prefix, std::set< std::string > const & whitelist, std::set< std::string > const & subtrees, unsigned writers, std::vector< manifest_entry > & manifest );
 
 #endif // #ifndef TAR_HPP_INCLUDED
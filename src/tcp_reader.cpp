@@ -8,11 +8,21 @@
 
 #include "tcp_reader.hpp"
 #include "error.hpp"
+#include "thread.hpp"
+#include "message.hpp"
+#include <map>
+#include <vector>
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
+#include <cstring>
 
 #ifdef _WIN32
-# include <winsock.h>
+# include <winsock2.h>
+# include <ws2tcpip.h>
+
+typedef int socklen_t;
+
 #else
 
 #include <sys/types.h>
@@ -23,6 +33,8 @@
 #include <errno.h>
 #include <unistd.h>
 #include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
 
 typedef int SOCKET;
 
@@ -40,88 +52,362 @@ inline int WSAGetLastError()
 
 #endif
 
-static bool is_dotted_numeric( char const * p )
+// resolver, caching the addresses of each host for the lifetime of the process
+
+typedef std::vector< char > tcp_address; // sockaddr_in or sockaddr_in6
+
+static mutex s_resolver_mx;
+static std::map< std::string, std::vector< tcp_address > > s_resolver_cache;
+
+// 'cached' is set when the addresses come from the cache
+static std::vector< tcp_address > resolve( std::string const & host, int port, std::string const & name, bool refresh, bool & cached )
 {
-    for( ; *p; ++p )
     {
-        if( !( *p >= '0' && *p <= '9' ) && *p != '.' )
+        scoped_lock lock( s_resolver_mx );
+
+        std::map< std::string, std::vector< tcp_address > >::const_iterator i = s_resolver_cache.find( name );
+
+        if( i != s_resolver_cache.end() && !refresh )
         {
-            return false;
+            cached = true;
+            return i->second;
         }
     }
 
-    return true;
+    cached = false;
+
+    // [::1] -> ::1
+
+    std::string h = host;
+
+    if( h.size() >= 2 && h[ 0 ] == '[' && h[ h.size() - 1 ] == ']' )
+    {
+        h = h.substr( 1, h.size() - 2 );
+    }
+
+    char service[ 32 ];
+    std::sprintf( service, "%d", port );
+
+    addrinfo hints;
+    std::memset( &hints, 0, sizeof( hints ) );
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    addrinfo * ai = 0;
+
+    int r = ::getaddrinfo( h.c_str(), service, &hints, &ai );
+
+    if( r != 0 )
+    {
+        throw_error( host, std::string( "unable to resolve host name: " ) + gai_strerror( r ) );
+    }
+
+    // alternate between the address families, starting with the
+    // preferred one, as recommended by RFC 8305
+
+    std::vector< tcp_address > first, second;
+
+    int family = ai->ai_family;
+
+    for( addrinfo * p = ai; p; p = p->ai_next )
+    {
+        if( p->ai_family != AF_INET && p->ai_family != AF_INET6 ) continue;
+
+        char const * q = reinterpret_cast< char const* >( p->ai_addr );
+        ( p->ai_family == family? first: second ).push_back( tcp_address( q, q + p->ai_addrlen ) );
+    }
+
+    ::freeaddrinfo( ai );
+
+    std::vector< tcp_address > v;
+
+    for( std::size_t i = 0; i < first.size() || i < second.size(); ++i )
+    {
+        if( i < first.size() ) v.push_back( first[ i ] );
+        if( i < second.size() ) v.push_back( second[ i ] );
+    }
+
+    if( v.empty() )
+    {
+        throw_error( host, "unable to resolve host name" );
+    }
+
+    scoped_lock lock( s_resolver_mx );
+
+    s_resolver_cache[ name ] = v;
+
+    return v;
 }
 
-tcp_reader::tcp_reader( std::string const & host, int port )
+static void set_nonblocking( SOCKET sk, bool nb )
 {
-    {
-        char buffer[ 32 ];
-        std::sprintf( buffer, "%d", port );
+#if defined( _WIN32 )
 
-        name_ = host + ':' + buffer;
+    u_long v = nb;
+    ioctlsocket( sk, FIONBIO, &v );
+
+#else
+
+    int flags = fcntl( sk, F_GETFL );
+    fcntl( sk, F_SETFL, nb? flags | O_NONBLOCK: flags & ~O_NONBLOCK );
+
+#endif
+}
+
+static bool connect_in_progress( int err )
+{
+#if defined( _WIN32 )
+
+    return err == WSAEWOULDBLOCK;
+
+#else
+
+    return err == EINPROGRESS;
+
+#endif
+}
+
+#if defined( _WIN32 )
+
+int const connect_timed_out = WSAETIMEDOUT;
+
+#else
+
+int const connect_timed_out = ETIMEDOUT;
+
+#endif
+
+// waits up to 'seconds' (forever if negative) for pending connects to
+// complete; returns the indices of the completed ones in 'ready'
+static void wait_connect( std::vector< SOCKET > const & v, double seconds, std::vector< std::size_t > & ready )
+{
+    ready.clear();
+
+    int ms = seconds < 0? -1: static_cast< int >( seconds * 1000 );
+
+#if defined( _WIN32 )
+
+    fd_set wfds, efds;
+
+    FD_ZERO( &wfds );
+    FD_ZERO( &efds );
+
+    for( std::size_t i = 0; i < v.size(); ++i )
+    {
+        FD_SET( v[ i ], &wfds );
+        FD_SET( v[ i ], &efds );
     }
 
-    if( port <= 0 || port >= 65536 )
+    timeval tv = { ms / 1000, ms % 1000 * 1000 };
+
+    if( ::select( 0, 0, &wfds, &efds, ms < 0? 0: &tv ) <= 0 ) return;
+
+    for( std::size_t i = 0; i < v.size(); ++i )
     {
-        throw_error( name_, "invalid port number" );
+        if( FD_ISSET( v[ i ], &wfds ) || FD_ISSET( v[ i ], &efds ) )
+        {
+            ready.push_back( i );
+        }
     }
 
-    unsigned long a;
+#else
 
-    char const * p = host.c_str();
+    std::vector< pollfd > pfds( v.size() );
 
-    if( is_dotted_numeric( p ) )
+    for( std::size_t i = 0; i < v.size(); ++i )
     {
-        a = inet_addr( p );
+        pfds[ i ].fd = v[ i ];
+        pfds[ i ].events = POLLOUT;
+        pfds[ i ].revents = 0;
+    }
 
-        if( a == INADDR_NONE || a == 0 )
+    if( ::poll( &pfds[ 0 ], pfds.size(), ms ) <= 0 ) return;
+
+    for( std::size_t i = 0; i < v.size(); ++i )
+    {
+        if( pfds[ i ].revents != 0 )
         {
-            throw_error( host, "invalid host address" );
+            ready.push_back( i );
         }
     }
-    else
+
+#endif
+}
+
+// connects to the first address that accepts, starting a new attempt
+// every 250 ms while the previous ones are pending (RFC 8305), and
+// giving up at 'deadline' (of monotonic_clock)
+static SOCKET connect_any( std::vector< tcp_address > const & addresses, std::string const & name, double deadline, int & error )
+{
+    double const attempt_delay = 0.25;
+
+    std::vector< SOCKET > pending;
+    std::vector< std::size_t > ready;
+
+    std::size_t next = 0;
+    double next_attempt = 0;
+
+    error = 0;
+
+    for( ;; )
     {
-        hostent const * q = gethostbyname( p );
+        if( next < addresses.size() && ( pending.empty() || monotonic_clock() >= next_attempt ) )
+        {
+            tcp_address const & a = addresses[ next++ ];
+            sockaddr const * sa = reinterpret_cast< sockaddr const* >( &a[ 0 ] );
+
+            SOCKET sk = ::socket( sa->sa_family, SOCK_STREAM, IPPROTO_TCP );
+
+            if( sk == INVALID_SOCKET )
+            {
+                error = WSAGetLastError();
+                continue;
+            }
+
+            set_nonblocking( sk, true );
 
-        if( q == 0 || q->h_length != 4 )
+            if( ::connect( sk, sa, static_cast< socklen_t >( a.size() ) ) == 0 )
+            {
+                pending.push_back( sk );
+                ready.assign( 1, pending.size() - 1 );
+            }
+            else
+            {
+                int r = WSAGetLastError();
+
+                if( !connect_in_progress( r ) )
+                {
+                    error = r;
+                    closesocket( sk );
+
+                    continue;
+                }
+
+                msg_printf( 2, "'%s': connecting to address %u", name.c_str(), static_cast< unsigned >( next ) );
+
+                pending.push_back( sk );
+                next_attempt = monotonic_clock() + attempt_delay;
+
+                ready.clear();
+            }
+        }
+        else if( pending.empty() )
+        {
+            return INVALID_SOCKET;
+        }
+        else
         {
-            throw_error( host, "unable to resolve host name" );
+            double now = monotonic_clock();
+
+            if( now >= deadline )
+            {
+                for( std::size_t j = 0; j < pending.size(); ++j )
+                {
+                    closesocket( pending[ j ] );
+                }
+
+                error = connect_timed_out;
+                return INVALID_SOCKET;
+            }
+
+            double timeout = deadline - now;
+
+            if( next < addresses.size() )
+            {
+                timeout = std::min( timeout, std::max( next_attempt - now, 0.0 ) );
+            }
+
+            wait_connect( pending, timeout, ready );
         }
 
-        a = *reinterpret_cast<unsigned long const *>( q->h_addr_list[0] );
+        // check the completed attempts, last first, so that indices stay valid
+
+        for( std::size_t i = ready.size(); i > 0; --i )
+        {
+            std::size_t k = ready[ i - 1 ];
+            SOCKET sk = pending[ k ];
+
+            int r = 0;
+            socklen_t n = sizeof( r );
+
+            if( ::getsockopt( sk, SOL_SOCKET, SO_ERROR, reinterpret_cast< char* >( &r ), &n ) != 0 )
+            {
+                r = WSAGetLastError();
+            }
+
+            if( r == 0 )
+            {
+                for( std::size_t j = 0; j < pending.size(); ++j )
+                {
+                    if( j != k ) closesocket( pending[ j ] );
+                }
+
+                set_nonblocking( sk, false );
+                return sk;
+            }
+
+            error = r;
+
+            closesocket( sk );
+            pending.erase( pending.begin() + k );
+        }
     }
+}
 
-    sk_ = ::socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+tcp_reader::tcp_reader( std::string const & host, int port, double timeout )
+{
+    {
+        char buffer[ 32 ];
+        std::sprintf( buffer, "%d", port );
 
-    if( sk_ == INVALID_SOCKET )
+        name_ = host + ':' + buffer;
+    }
+
+    if( port <= 0 || port >= 65536 )
     {
-        throw_socket_error( name_, "socket create error", WSAGetLastError() );
+        throw_error( name_, "invalid port number" );
     }
 
-    sockaddr_in addr = { AF_INET };
+    double deadline = monotonic_clock() + timeout;
 
-    addr.sin_addr.s_addr = a;
-    addr.sin_port = htons( static_cast<u_short>( port ) );
+    int error = 0;
+    bool cached = false;
 
-    int r = ::connect( sk_, (sockaddr const *)&addr, sizeof(addr) );
+    sk_ = connect_any( resolve( host, port, name_, false, cached ), name_, deadline, error );
 
-    if( r != 0 )
+    if( sk_ == INVALID_SOCKET && cached && error != connect_timed_out )
     {
-        int r2 = WSAGetLastError();
+        // the cached addresses may be out of date
+
+        msg_printf( 2, "'%s': resolving host name again", name_.c_str() );
 
-        closesocket( sk_ );
+        sk_ = connect_any( resolve( host, port, name_, true, cached ), name_, deadline, error );
+    }
 
-        throw_socket_error( name_, "TCP connect error", r2 );
+    if( sk_ == INVALID_SOCKET )
+    {
+        throw_socket_error( name_, "TCP connect error", error );
     }
 }
 
 tcp_reader::~tcp_reader()
 {
-    shutdown( sk_, 2 );
+    ::shutdown( sk_, 2 );
     closesocket( sk_ );
 }
 
+void tcp_reader::shutdown()
+{
+    ::shutdown( sk_, 2 );
+}
+
+std::ptrdiff_t tcp_reader::handle() const
+{
+    return sk_;
+}
+
 std::string tcp_reader::name() const
 {
     return name_;
@@ -153,9 +439,37 @@ void tcp_reader::write( void const * p, std::size_t n )
     }
 }
 
+bool tcp_reader::wait( double seconds )
+{
+    int ms = seconds > 0? static_cast< int >( seconds * 1000 ): 0;
+
+#if defined( _WIN32 )
+
+    fd_set fds;
+
+    FD_ZERO( &fds );
+    FD_SET( static_cast< SOCKET >( sk_ ), &fds );
+
+    timeval tv = { ms / 1000, ms % 1000 * 1000 };
+
+    return ::select( 0, &fds, 0, 0, &tv ) != 0;
+
+#else
+
+    pollfd pfd;
+    std::memset( &pfd, 0, sizeof( pfd ) );
+
+    pfd.fd = static_cast< int >( sk_ );
+    pfd.events = POLLIN;
+
+    return ::poll( &pfd, 1, ms ) != 0;
+
+#endif
+}
+
 #if defined( _WIN32 )
 
 static WSADATA s_wd;
-static int s_wsa_startup = WSAStartup( MAKEWORD( 1, 1 ), &s_wd );
+static int s_wsa_startup = WSAStartup( MAKEWORD( 2, 2 ), &s_wd );
 
 #endif // defined( _WIN32 )
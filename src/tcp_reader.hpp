@@ -11,6 +11,9 @@
 
 #include "basic_reader.hpp"
 
+// how long tcp_reader tries to connect, by default
+double const tcp_connect_timeout = 30;
+
 class tcp_reader: public basic_reader
 {
 private:
@@ -25,16 +28,24 @@ private:
 
 public:
 
-    explicit tcp_reader( std::string const & host, int port );
+    // gives up connecting after 'timeout' seconds
+    tcp_reader( std::string const & host, int port, double timeout = tcp_connect_timeout );
 
     ~tcp_reader();
 
     virtual std::string name() const;
     virtual std::size_t read( void * p, std::size_t n );
 
-protected:
-
     void write( void const * p, std::size_t n );
+
+    // waits up to 'seconds' for data; returns true when a read would not block
+    bool wait( double seconds );
+
+    // the socket, for use with an event loop
+    std::ptrdiff_t handle() const;
+
+    // makes pending and subsequent reads return end of data
+    void shutdown();
 };
 
 #endif // #ifndef TCP_READER_HPP_INCLUDED
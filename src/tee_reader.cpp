@@ -0,0 +1,189 @@
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "tee_reader.hpp"
+#include "cache.hpp"
+#include "message.hpp"
+#include "error.hpp"
+#include "fs.hpp"
+#include <cstring>
+#include <errno.h>
+
+tee_reader::tee_reader( basic_reader * pr, std::string const & fn ): pr_( pr ), fn_( fn ), f_( 0 ), prefix_( 0 ), prefix_size_( 0 ), source_failed_( false )
+{
+    if( !fn_.empty() )
+    {
+        temp_ = cache_temp_name( fn_ );
+
+        f_ = std::fopen( temp_.c_str(), "wb" );
+
+        if( f_ == 0 )
+        {
+            msg_printf( 1, "'%s': create error: %s", temp_.c_str(), std::strerror( errno ) );
+        }
+    }
+}
+
+tee_reader::tee_reader( basic_reader * pr, std::string const & fn, std::string const & temp, long long offset ): pr_( pr ), fn_( fn ), temp_( temp ), f_( 0 ), prefix_( 0 ), prefix_size_( offset ), source_failed_( false )
+{
+    prefix_ = std::fopen( temp_.c_str(), "rb" );
+
+    if( prefix_ == 0 )
+    {
+        throw_errno_error( temp_, "open error", errno );
+    }
+
+    f_ = std::fopen( temp_.c_str(), "ab" );
+
+    if( f_ == 0 )
+    {
+        int r = errno;
+
+        std::fclose( prefix_ );
+        throw_errno_error( temp_, "open error", r );
+    }
+}
+
+tee_reader::~tee_reader()
+{
+    if( prefix_ )
+    {
+        std::fclose( prefix_ );
+    }
+
+    if( f_ && source_failed_ )
+    {
+        // keep what has been downloaded, to be resumed later
+
+        int r = std::fclose( f_ );
+        f_ = 0;
+
+        if( r == 0 && fs_rename( temp_, fn_ + ".partial" ) == 0 )
+        {
+            cache_keep_validator( fn_, validator_ );
+
+            msg_printf( 1, "kept partial download '%s'", ( fn_ + ".partial" ).c_str() );
+            return;
+        }
+
+        std::remove( temp_.c_str() );
+    }
+
+    discard();
+}
+
+void tee_reader::discard()
+{
+    if( f_ )
+    {
+        std::fclose( f_ );
+        f_ = 0;
+
+        std::remove( temp_.c_str() );
+    }
+}
+
+std::string tee_reader::name() const
+{
+    return pr_->name();
+}
+
+std::size_t tee_reader::read( void * p, std::size_t n )
+{
+    if( prefix_size_ > 0 )
+    {
+        if( static_cast< unsigned long long >( prefix_size_ ) < n )
+        {
+            n = static_cast< std::size_t >( prefix_size_ );
+        }
+
+        std::size_t r = std::fread( p, 1, n, prefix_ );
+
+        if( r == 0 )
+        {
+            throw_errno_error( temp_, "read error", std::ferror( prefix_ )? errno: 0 );
+        }
+
+        prefix_size_ -= r;
+
+        if( prefix_size_ == 0 )
+        {
+            std::fclose( prefix_ );
+            prefix_ = 0;
+        }
+
+        return r;
+    }
+
+    std::size_t r = 0;
+
+    try
+    {
+        r = pr_->read( p, n );
+    }
+    catch( std::exception const & )
+    {
+        source_failed_ = true;
+        throw;
+    }
+
+    if( f_ && r > 0 && std::fwrite( p, 1, r, f_ ) != r )
+    {
+        msg_printf( 1, "'%s': write error: %s", temp_.c_str(), std::strerror( errno ) );
+        discard();
+    }
+
+    return r;
+}
+
+void tee_reader::set_validator( std::string const & v )
+{
+    validator_ = v;
+}
+
+void tee_reader::commit()
+{
+    if( f_ == 0 ) return;
+
+    // the input has already been used, so failing to read the rest of
+    // it only means that it isn't cached
+
+    try
+    {
+        for( ;; )
+        {
+            char buffer[ 4096 ];
+
+            if( read( buffer, sizeof( buffer ) ) == 0 ) break;
+        }
+    }
+    catch( std::exception const & x )
+    {
+        msg_printf( 1, "%s", x.what() );
+        msg_printf( 1, "not caching '%s'", fn_.c_str() );
+
+        source_failed_ = false;
+        discard();
+    }
+
+    if( f_ == 0 ) return;
+
+    int r = std::fclose( f_ );
+    f_ = 0;
+
+    if( r != 0 || fs_rename( temp_, fn_ ) != 0 )
+    {
+        msg_printf( 1, "'%s': rename error: %s", temp_.c_str(), std::strerror( errno ) );
+        std::remove( temp_.c_str() );
+    }
+    else
+    {
+        cache_keep_validator( fn_, std::string() );
+        msg_printf( 2, "cached '%s'", fn_.c_str() );
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef TEE_READER_HPP_INCLUDED
+#define TEE_READER_HPP_INCLUDED
+
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "basic_reader.hpp"
+#include <cstdio>
+
+// passes the data read from 'pr' through, storing a copy into the file 'fn';
+// the copy is written to a temporary file that is renamed to 'fn' by commit().
+// If commit() isn't called, the copy is discarded, unless reading from 'pr'
+// has failed; then it's kept as fn + ".partial", so that the download can be
+// resumed. An empty 'fn' disables the copy. Errors writing the copy are
+// reported, but are not fatal.
+
+class tee_reader: public basic_reader
+{
+private:
+
+    basic_reader * pr_;
+
+    std::string fn_;
+    std::string temp_;
+
+    std::FILE * f_;
+
+    // when resuming, the data already in temp_ is read from here first
+    std::FILE * prefix_;
+    long long prefix_size_;
+
+    bool source_failed_;
+
+    std::string validator_;
+
+private:
+
+    tee_reader( tee_reader const & );
+    tee_reader& operator=( tee_reader const & );
+
+    void discard();
+
+public:
+
+    tee_reader( basic_reader * pr, std::string const & fn );
+
+    // resumes a download: 'temp', obtained from cache_claim_partial,
+    // holds the first 'offset' bytes, and 'pr' yields the rest
+    tee_reader( basic_reader * pr, std::string const & fn, std::string const & temp, long long offset );
+
+    ~tee_reader();
+
+    virtual std::string name() const;
+    virtual std::size_t read( void * p, std::size_t n );
+
+    // 'v' identifies the version being downloaded (http_reader::validator),
+    // and is kept with a partial download for resuming it
+    void set_validator( std::string const & v );
+
+    // reads the rest of the input and renames the copy to 'fn'; errors
+    // are reported and discard the copy, but are not thrown
+    void commit();
+};
+
+#endif // #ifndef TEE_READER_HPP_INCLUDED
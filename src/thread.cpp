@@ -0,0 +1,245 @@
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "thread.hpp"
+#include <stdexcept>
+
+#if defined( _WIN32 )
+
+#define _WIN32_WINNT 0x600
+
+#include <windows.h>
+#include <process.h>
+
+mutex::mutex(): p_( new CRITICAL_SECTION )
+{
+    InitializeCriticalSection( static_cast< CRITICAL_SECTION* >( p_ ) );
+}
+
+mutex::~mutex()
+{
+    DeleteCriticalSection( static_cast< CRITICAL_SECTION* >( p_ ) );
+    delete static_cast< CRITICAL_SECTION* >( p_ );
+}
+
+void mutex::lock()
+{
+    EnterCriticalSection( static_cast< CRITICAL_SECTION* >( p_ ) );
+}
+
+void mutex::unlock()
+{
+    LeaveCriticalSection( static_cast< CRITICAL_SECTION* >( p_ ) );
+}
+
+condition::condition(): p_( new CONDITION_VARIABLE )
+{
+    InitializeConditionVariable( static_cast< CONDITION_VARIABLE* >( p_ ) );
+}
+
+condition::~condition()
+{
+    delete static_cast< CONDITION_VARIABLE* >( p_ );
+}
+
+void condition::wait( mutex & m )
+{
+    SleepConditionVariableCS( static_cast< CONDITION_VARIABLE* >( p_ ), static_cast< CRITICAL_SECTION* >( m.p_ ), INFINITE );
+}
+
+bool condition::wait_for( mutex & m, double seconds )
+{
+    DWORD ms = seconds > 0? static_cast< DWORD >( seconds * 1000 ): 0;
+    return SleepConditionVariableCS( static_cast< CONDITION_VARIABLE* >( p_ ), static_cast< CRITICAL_SECTION* >( m.p_ ), ms ) != 0;
+}
+
+void condition::notify_one()
+{
+    WakeConditionVariable( static_cast< CONDITION_VARIABLE* >( p_ ) );
+}
+
+void condition::notify_all()
+{
+    WakeAllConditionVariable( static_cast< CONDITION_VARIABLE* >( p_ ) );
+}
+
+struct thread_start
+{
+    void (*f)( void * );
+    void * arg;
+};
+
+static unsigned __stdcall thread_proc( void * pv )
+{
+    thread_start ts = *static_cast< thread_start* >( pv );
+    delete static_cast< thread_start* >( pv );
+
+    ts.f( ts.arg );
+    return 0;
+}
+
+thread::thread( void (*f)( void * ), void * arg )
+{
+    thread_start * pts = new thread_start;
+
+    pts->f = f;
+    pts->arg = arg;
+
+    uintptr_t h = _beginthreadex( 0, 0, thread_proc, pts, 0, 0 );
+
+    if( h == 0 )
+    {
+        delete pts;
+        throw std::runtime_error( "could not create thread" );
+    }
+
+    p_ = reinterpret_cast< void* >( h );
+}
+
+thread::~thread()
+{
+    WaitForSingleObject( static_cast< HANDLE >( p_ ), INFINITE );
+    CloseHandle( static_cast< HANDLE >( p_ ) );
+}
+
+double monotonic_clock()
+{
+    return GetTickCount64() / 1000.0;
+}
+
+unsigned hardware_concurrency()
+{
+    SYSTEM_INFO si;
+    GetSystemInfo( &si );
+
+    return si.dwNumberOfProcessors > 0? si.dwNumberOfProcessors: 1;
+}
+
+#else
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+mutex::mutex(): p_( new pthread_mutex_t )
+{
+    pthread_mutex_init( static_cast< pthread_mutex_t* >( p_ ), 0 );
+}
+
+mutex::~mutex()
+{
+    pthread_mutex_destroy( static_cast< pthread_mutex_t* >( p_ ) );
+    delete static_cast< pthread_mutex_t* >( p_ );
+}
+
+void mutex::lock()
+{
+    pthread_mutex_lock( static_cast< pthread_mutex_t* >( p_ ) );
+}
+
+void mutex::unlock()
+{
+    pthread_mutex_unlock( static_cast< pthread_mutex_t* >( p_ ) );
+}
+
+condition::condition(): p_( new pthread_cond_t )
+{
+    pthread_cond_init( static_cast< pthread_cond_t* >( p_ ), 0 );
+}
+
+condition::~condition()
+{
+    pthread_cond_destroy( static_cast< pthread_cond_t* >( p_ ) );
+    delete static_cast< pthread_cond_t* >( p_ );
+}
+
+void condition::wait( mutex & m )
+{
+    pthread_cond_wait( static_cast< pthread_cond_t* >( p_ ), static_cast< pthread_mutex_t* >( m.p_ ) );
+}
+
+bool condition::wait_for( mutex & m, double seconds )
+{
+    timespec ts;
+    clock_gettime( CLOCK_REALTIME, &ts );
+
+    if( seconds > 0 )
+    {
+        long long ns = ts.tv_nsec + static_cast< long long >( seconds * 1e9 );
+
+        ts.tv_sec += static_cast< time_t >( ns / 1000000000 );
+        ts.tv_nsec = static_cast< long >( ns % 1000000000 );
+    }
+
+    return pthread_cond_timedwait( static_cast< pthread_cond_t* >( p_ ), static_cast< pthread_mutex_t* >( m.p_ ), &ts ) == 0;
+}
+
+void condition::notify_one()
+{
+    pthread_cond_signal( static_cast< pthread_cond_t* >( p_ ) );
+}
+
+void condition::notify_all()
+{
+    pthread_cond_broadcast( static_cast< pthread_cond_t* >( p_ ) );
+}
+
+struct thread_start
+{
+    void (*f)( void * );
+    void * arg;
+};
+
+extern "C" void * thread_proc( void * pv )
+{
+    thread_start ts = *static_cast< thread_start* >( pv );
+    delete static_cast< thread_start* >( pv );
+
+    ts.f( ts.arg );
+    return 0;
+}
+
+thread::thread( void (*f)( void * ), void * arg ): p_( new pthread_t )
+{
+    thread_start * pts = new thread_start;
+
+    pts->f = f;
+    pts->arg = arg;
+
+    int r = pthread_create( static_cast< pthread_t* >( p_ ), 0, thread_proc, pts );
+
+    if( r != 0 )
+    {
+        delete pts;
+        delete static_cast< pthread_t* >( p_ );
+
+        throw std::runtime_error( "could not create thread" );
+    }
+}
+
+thread::~thread()
+{
+    pthread_join( *static_cast< pthread_t* >( p_ ), 0 );
+    delete static_cast< pthread_t* >( p_ );
+}
+
+double monotonic_clock()
+{
+    timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+unsigned hardware_concurrency()
+{
+    long n = sysconf( _SC_NPROCESSORS_ONLN );
+    return n > 0? static_cast< unsigned >( n ): 1;
+}
+
+#endif // defined( _WIN32 )
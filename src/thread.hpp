@@ -0,0 +1,112 @@
+#ifndef THREAD_HPP_INCLUDED
+#define THREAD_HPP_INCLUDED
+
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+// minimal portable threading primitives (pthreads or Win32)
+
+class mutex
+{
+private:
+
+    void * p_;
+
+private:
+
+    mutex( mutex const & );
+    mutex& operator=( mutex const & );
+
+public:
+
+    mutex();
+    ~mutex();
+
+    void lock();
+    void unlock();
+
+    friend class condition;
+};
+
+class scoped_lock
+{
+private:
+
+    mutex & m_;
+
+private:
+
+    scoped_lock( scoped_lock const & );
+    scoped_lock& operator=( scoped_lock const & );
+
+public:
+
+    explicit scoped_lock( mutex & m ): m_( m )
+    {
+        m_.lock();
+    }
+
+    ~scoped_lock()
+    {
+        m_.unlock();
+    }
+};
+
+class condition
+{
+private:
+
+    void * p_;
+
+private:
+
+    condition( condition const & );
+    condition& operator=( condition const & );
+
+public:
+
+    condition();
+    ~condition();
+
+    // 'm' must be locked by the calling thread
+    void wait( mutex & m );
+
+    // as wait, but for at most 'seconds'; returns false on timeout
+    bool wait_for( mutex & m, double seconds );
+
+    void notify_one();
+    void notify_all();
+};
+
+class thread
+{
+private:
+
+    void * p_;
+
+private:
+
+    thread( thread const & );
+    thread& operator=( thread const & );
+
+public:
+
+    // throws on error; 'f' must not throw
+    thread( void (*f)( void * ), void * arg );
+
+    // joins
+    ~thread();
+};
+
+// seconds since an unspecified point; unaffected by changes of the system time
+double monotonic_clock();
+
+// the number of processors, at least 1
+unsigned hardware_concurrency();
+
+#endif // #ifndef THREAD_HPP_INCLUDED
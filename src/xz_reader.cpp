@@ -0,0 +1,906 @@
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "xz_reader.hpp"
+#include "crc.hpp"
+#include "error.hpp"
+#include "message.hpp"
+#include "lzma_pool.hpp"
+#include "lzma/Lzma2Dec.h"
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+// blocks larger than this are decoded in place, rather than in memory
+static long long const max_block_size = 256 << 20;
+
+// the blocks read ahead hold at most this many bytes of input and output
+// together, except that there's always at least one
+static long long const max_read_ahead = 256 << 20;
+
+struct xz_block
+{
+    std::size_t header_size;
+
+    // -1 when not stored in the block header
+    long long compressed_size;
+    long long uncompressed_size;
+
+    unsigned char prop; // the LZMA2 dictionary size
+    int check;
+
+    pool_buffer input;
+    pool_buffer output;
+
+    // the next byte of output to return
+    std::size_t position;
+
+    // the check stored after the block, and the one computed
+    std::vector< unsigned char > stored;
+
+    unsigned crc32;
+    unsigned long long crc64;
+
+    // when decoding in place
+    long long consumed;
+    long long produced;
+
+    // set by the decoding thread, under xz_reader::mx_
+    bool done;
+    std::string error;
+
+    // the output can be returned; only used by the reading thread
+    bool ready;
+
+    xz_block(): header_size( 0 ), compressed_size( -1 ), uncompressed_size( -1 ), prop( 0 ), check( 0 ), position( 0 ), crc32( 0 ), crc64( 0 ), consumed( 0 ), produced( 0 ), done( false ), ready( false )
+    {
+    }
+};
+
+static std::size_t check_size( int check )
+{
+    return check == 0? 0: 4u << ( ( check - 1 ) / 3 );
+}
+
+static unsigned long long get_le( unsigned char const * p, int n )
+{
+    unsigned long long r = 0;
+
+    for( int i = n - 1; i >= 0; --i )
+    {
+        r = ( r << 8 ) | p[ i ];
+    }
+
+    return r;
+}
+
+static void update_check( xz_block & b, void const * p, std::size_t n )
+{
+    if( b.check == 1 )
+    {
+        b.crc32 = crc32_update( b.crc32, p, n );
+    }
+    else if( b.check == 4 )
+    {
+        b.crc64 = crc64_update( b.crc64, p, n );
+    }
+}
+
+// checks that aren't supported always match
+static bool check_matches( xz_block const & b )
+{
+    if( b.check == 1 )
+    {
+        return get_le( &b.stored[ 0 ], 4 ) == b.crc32;
+    }
+    else if( b.check == 4 )
+    {
+        return get_le( &b.stored[ 0 ], 8 ) == b.crc64;
+    }
+    else
+    {
+        return true;
+    }
+}
+
+// a variable-length integer of the xz format at h[ i ], advancing i
+static bool decode_vli( unsigned char const * h, std::size_t n, std::size_t & i, unsigned long long & v )
+{
+    v = 0;
+
+    for( int k = 0; k < 9 && i < n; ++k )
+    {
+        unsigned char b = h[ i++ ];
+
+        v |= static_cast< unsigned long long >( b & 0x7F ) << ( 7 * k );
+
+        if( ( b & 0x80 ) == 0 )
+        {
+            return b != 0 || k == 0;
+        }
+    }
+
+    return false;
+}
+
+// decodes a block from memory to memory; runs on the decoding threads
+static void decode_block( xz_block & b )
+{
+    CLzma2Dec st;
+
+    Lzma2Dec_Construct( &st );
+
+    if( Lzma2Dec_AllocateProbs( &st, b.prop, lzma_pool() ) != SZ_OK )
+    {
+        throw std::runtime_error( "could not allocate LZMA2 state" );
+    }
+
+    SizeT size = static_cast< SizeT >( b.uncompressed_size );
+
+    b.output.resize( size );
+
+    Byte dummy = 0;
+
+    // the output is the dictionary
+    st.decoder.dic = size? &b.output[ 0 ]: &dummy;
+    st.decoder.dicBufSize = size;
+
+    Lzma2Dec_Init( &st );
+
+    SizeT m = b.input.size();
+    ELzmaStatus status = LZMA_STATUS_NOT_SPECIFIED;
+
+    SRes r = Lzma2Dec_DecodeToDic( &st, size, b.input.empty()? &dummy: &b.input[ 0 ], &m, LZMA_FINISH_END, &status );
+
+    SizeT pos = st.decoder.dicPos;
+
+    st.decoder.dic = 0;
+    Lzma2Dec_FreeProbs( &st, lzma_pool() );
+
+    if( r != SZ_OK || status != LZMA_STATUS_FINISHED_WITH_MARK || pos != size || m != b.input.size() )
+    {
+        throw std::runtime_error( "LZMA2 data error" );
+    }
+
+    b.input.release();
+
+    update_check( b, size? &b.output[ 0 ]: &dummy, size );
+
+    if( !check_matches( b ) )
+    {
+        throw std::runtime_error( "integrity check failed" );
+    }
+}
+
+xz_reader::xz_reader( basic_reader * pr ): pr_( pr ), in_( 0 ), m_( 0 ), check_( 0 ), eof_( false ), next_( 0 ), allocated_( false ), current_( 0 ), out_( 0 ), depth_( hardware_concurrency() + 1 ), stop_( false )
+{
+    typedef char assert_large_enough[ sizeof( state_ ) >= sizeof( CLzma2Dec )? 1: -1 ];
+    (void)sizeof( assert_large_enough );
+
+    Lzma2Dec_Construct( (CLzma2Dec*)state_ );
+
+    if( !read_stream_header() )
+    {
+        throw_error( pr_->name(), "could not read xz header" );
+    }
+}
+
+xz_reader::~xz_reader()
+{
+    {
+        scoped_lock lock( mx_ );
+
+        stop_ = true;
+        cn_.notify_all();
+    }
+
+    for( std::vector< thread * >::iterator i = threads_.begin(); i != threads_.end(); ++i )
+    {
+        delete *i; // joins
+    }
+
+    for( std::deque< xz_block * >::iterator i = blocks_.begin(); i != blocks_.end(); ++i )
+    {
+        delete *i;
+    }
+
+    delete next_;
+    delete current_;
+
+    if( allocated_ )
+    {
+        CLzma2Dec * st = (CLzma2Dec*)state_;
+        Lzma2Dec_Free( st, lzma_pool() );
+    }
+}
+
+std::string xz_reader::name() const
+{
+    return pr_->name();
+}
+
+void xz_reader::thread_proc( void * pv )
+{
+    static_cast< xz_reader* >( pv )->work();
+}
+
+void xz_reader::work()
+{
+    scoped_lock lock( mx_ );
+
+    for( ;; )
+    {
+        while( jobs_.empty() && !stop_ )
+        {
+            cn_.wait( mx_ );
+        }
+
+        if( stop_ ) return;
+
+        xz_block * pb = jobs_.front();
+        jobs_.pop_front();
+
+        std::string error;
+
+        mx_.unlock();
+
+        try
+        {
+            decode_block( *pb );
+        }
+        catch( std::exception const & x )
+        {
+            error = x.what();
+        }
+
+        mx_.lock();
+
+        pb->error = error;
+        pb->done = true;
+
+        cn_.notify_all();
+    }
+}
+
+// input
+
+bool xz_reader::refill()
+{
+    if( m_ != 0 )
+    {
+        return true;
+    }
+
+    void const * p = 0;
+    std::size_t r = 1048576;
+
+    if( pr_->read_direct( p, r ) )
+    {
+        in_ = static_cast< unsigned char const* >( p );
+    }
+    else
+    {
+        r = pr_->read( buffer_, N );
+        in_ = buffer_;
+    }
+
+    m_ = r;
+    return r != 0;
+}
+
+std::size_t xz_reader::read_input( void * p, std::size_t n )
+{
+    unsigned char * q = static_cast< unsigned char* >( p );
+
+    std::size_t r = 0;
+
+    while( r < n && refill() )
+    {
+        std::size_t k = std::min( n - r, m_ );
+
+        std::memcpy( q + r, in_, k );
+
+        in_ += k;
+        m_ -= k;
+
+        r += k;
+    }
+
+    return r;
+}
+
+void xz_reader::read_exact( void * p, std::size_t n )
+{
+    if( read_input( p, n ) < n )
+    {
+        throw_error( name(), "unexpected end of file" );
+    }
+}
+
+unsigned long long xz_reader::read_vli( std::vector< unsigned char > & data )
+{
+    unsigned long long v = 0;
+
+    for( int k = 0; k < 9; ++k )
+    {
+        unsigned char b = 0;
+        read_exact( &b, 1 );
+
+        data.push_back( b );
+
+        v |= static_cast< unsigned long long >( b & 0x7F ) << ( 7 * k );
+
+        if( ( b & 0x80 ) == 0 )
+        {
+            if( b == 0 && k != 0 ) break;
+            return v;
+        }
+    }
+
+    throw_error( name(), "invalid index" );
+    return 0;
+}
+
+// container structure
+
+// reads the header of the next stream, skipping the padding before
+// it; returns false at the end of the input
+bool xz_reader::read_stream_header()
+{
+    unsigned char h[ 12 ];
+
+    for( ;; )
+    {
+        std::size_t r = read_input( h, 4 );
+
+        if( r == 0 )
+        {
+            return false;
+        }
+
+        if( r < 4 )
+        {
+            throw_error( name(), "unexpected end of file" );
+        }
+
+        if( h[ 0 ] != 0 || h[ 1 ] != 0 || h[ 2 ] != 0 || h[ 3 ] != 0 )
+        {
+            break;
+        }
+    }
+
+    read_exact( h + 4, 8 );
+
+    static unsigned char const magic[] = { 0xFD, '7', 'z', 'X', 'Z', 0 };
+
+    if( std::memcmp( h, magic, 6 ) != 0 )
+    {
+        throw_error( name(), "not an xz file" );
+    }
+
+    if( crc32_update( 0, h + 6, 2 ) != get_le( h + 8, 4 ) )
+    {
+        throw_error( name(), "stream header checksum mismatch" );
+    }
+
+    if( h[ 6 ] != 0 || ( h[ 7 ] & 0xF0 ) != 0 )
+    {
+        throw_error( name(), "unsupported stream flags" );
+    }
+
+    stream_flags_[ 0 ] = h[ 6 ];
+    stream_flags_[ 1 ] = h[ 7 ];
+
+    check_ = h[ 7 ];
+
+    if( check_ != 0 && check_ != 1 && check_ != 4 )
+    {
+        msg_printf( 1, "'%s': integrity check %d is not supported, skipping", name().c_str(), check_ );
+    }
+
+    records_.clear();
+
+    return true;
+}
+
+// reads the index, whose indicator has been read, and the stream footer
+void xz_reader::read_index()
+{
+    std::vector< unsigned char > data( 1, 0 );
+
+    unsigned long long count = read_vli( data );
+
+    if( count != records_.size() )
+    {
+        throw_error( name(), "index does not match the blocks" );
+    }
+
+    for( std::size_t i = 0; i < count; ++i )
+    {
+        unsigned long long unpadded = read_vli( data );
+        unsigned long long uncompressed = read_vli( data );
+
+        if( unpadded != records_[ i ].first || uncompressed != records_[ i ].second )
+        {
+            throw_error( name(), "index does not match the blocks" );
+        }
+    }
+
+    while( data.size() % 4 != 0 )
+    {
+        unsigned char b = 0;
+        read_exact( &b, 1 );
+
+        if( b != 0 )
+        {
+            throw_error( name(), "invalid index" );
+        }
+
+        data.push_back( b );
+    }
+
+    unsigned char h[ 4 ];
+    read_exact( h, 4 );
+
+    if( crc32_update( 0, &data[ 0 ], data.size() ) != get_le( h, 4 ) )
+    {
+        throw_error( name(), "index checksum mismatch" );
+    }
+
+    unsigned char f[ 12 ];
+    read_exact( f, 12 );
+
+    if( crc32_update( 0, f + 4, 6 ) != get_le( f, 4 ) )
+    {
+        throw_error( name(), "stream footer checksum mismatch" );
+    }
+
+    if( f[ 10 ] != 'Y' || f[ 11 ] != 'Z' || f[ 8 ] != stream_flags_[ 0 ] || f[ 9 ] != stream_flags_[ 1 ] || ( get_le( f + 4, 4 ) + 1 ) * 4 != data.size() + 4 )
+    {
+        throw_error( name(), "invalid stream footer" );
+    }
+}
+
+// reads the next block header, passing over the index and the stream
+// boundaries; returns 0 at the end of the input
+xz_block * xz_reader::read_block_header()
+{
+    for( ;; )
+    {
+        unsigned char h[ 1024 ];
+
+        read_exact( h, 1 );
+
+        if( h[ 0 ] == 0 )
+        {
+            read_index();
+
+            if( !read_stream_header() )
+            {
+                return 0;
+            }
+
+            continue;
+        }
+
+        std::size_t size = ( h[ 0 ] + 1 ) * 4;
+
+        read_exact( h + 1, size - 1 );
+
+        std::size_t n = size - 4;
+
+        if( crc32_update( 0, h, n ) != get_le( h + n, 4 ) )
+        {
+            throw_error( name(), "block header checksum mismatch" );
+        }
+
+        unsigned char flags = h[ 1 ];
+
+        if( flags & 0x3C )
+        {
+            throw_error( name(), "unsupported block flags" );
+        }
+
+        std::size_t i = 2;
+        unsigned long long v = 0;
+
+        long long compressed = -1;
+
+        if( flags & 0x40 )
+        {
+            if( !decode_vli( h, n, i, v ) || v == 0 || v >= ( 1ULL << 62 ) )
+            {
+                throw_error( name(), "invalid block header" );
+            }
+
+            compressed = v;
+        }
+
+        long long uncompressed = -1;
+
+        if( flags & 0x80 )
+        {
+            if( !decode_vli( h, n, i, v ) || v >= ( 1ULL << 62 ) )
+            {
+                throw_error( name(), "invalid block header" );
+            }
+
+            uncompressed = v;
+        }
+
+        if( ( flags & 3 ) != 0 )
+        {
+            throw_error( name(), "unsupported filter chain" );
+        }
+
+        unsigned long long id = 0, props = 0;
+
+        if( !decode_vli( h, n, i, id ) || !decode_vli( h, n, i, props ) )
+        {
+            throw_error( name(), "invalid block header" );
+        }
+
+        if( id != 0x21 )
+        {
+            throw_error( name(), "unsupported filter" );
+        }
+
+        if( props != 1 || i >= n || h[ i ] > 40 )
+        {
+            throw_error( name(), "invalid block header" );
+        }
+
+        unsigned char prop = h[ i++ ];
+
+        for( ; i < n; ++i )
+        {
+            if( h[ i ] != 0 )
+            {
+                throw_error( name(), "invalid block header" );
+            }
+        }
+
+        xz_block * pb = new xz_block;
+
+        pb->header_size = size;
+        pb->compressed_size = compressed;
+        pb->uncompressed_size = uncompressed;
+        pb->prop = prop;
+        pb->check = check_;
+
+        return pb;
+    }
+}
+
+// reads the padding and the check after the data of 'pb'
+void xz_reader::read_check( xz_block * pb )
+{
+    unsigned char padding[ 4 ] = { 0 };
+
+    std::size_t k = static_cast< std::size_t >( ( 4 - pb->compressed_size % 4 ) % 4 );
+
+    read_exact( padding, k );
+
+    if( padding[ 0 ] != 0 || padding[ 1 ] != 0 || padding[ 2 ] != 0 )
+    {
+        throw_error( name(), "invalid block padding" );
+    }
+
+    pb->stored.resize( check_size( pb->check ) );
+
+    if( !pb->stored.empty() )
+    {
+        read_exact( &pb->stored[ 0 ], pb->stored.size() );
+    }
+
+    records_.push_back( std::make_pair( pb->header_size + pb->compressed_size + pb->stored.size(), pb->uncompressed_size ) );
+}
+
+// reads the blocks that can be decoded in memory ahead, up to depth_ of
+// them and max_read_ahead bytes, and queues them for the decoding
+// threads; a block that needs to be decoded in place
+// is started when those before it have been returned
+void xz_reader::read_ahead()
+{
+    while( current_ == 0 && blocks_.size() < depth_ )
+    {
+        if( next_ == 0 )
+        {
+            if( eof_ ) return;
+
+            next_ = read_block_header();
+
+            if( next_ == 0 )
+            {
+                eof_ = true;
+                return;
+            }
+        }
+
+        xz_block * pb = next_;
+
+        if( !blocks_.empty() && pb->compressed_size >= 0 && pb->uncompressed_size >= 0 )
+        {
+            long long size = pb->compressed_size + pb->uncompressed_size;
+
+            for( std::deque< xz_block * >::const_iterator i = blocks_.begin(); i != blocks_.end(); ++i )
+            {
+                size += ( *i )->compressed_size + ( *i )->uncompressed_size;
+            }
+
+            if( size > max_read_ahead ) return;
+        }
+
+        if( pb->compressed_size < 0 || pb->uncompressed_size < 0 || pb->compressed_size > max_block_size || pb->uncompressed_size > max_block_size )
+        {
+            if( blocks_.empty() )
+            {
+                CLzma2Dec * st = (CLzma2Dec*)state_;
+
+                if( Lzma2Dec_Allocate( st, pb->prop, lzma_pool() ) != SZ_OK )
+                {
+                    throw_error( name(), "could not allocate LZMA2 state" );
+                }
+
+                allocated_ = true;
+
+                Lzma2Dec_Init( st );
+
+                out_ = 0;
+
+                current_ = pb;
+                next_ = 0;
+            }
+
+            return;
+        }
+
+        pb->input.resize( static_cast< std::size_t >( pb->compressed_size ) );
+        read_exact( &pb->input[ 0 ], pb->input.size() );
+
+        read_check( pb );
+
+        blocks_.push_back( pb );
+        next_ = 0;
+
+        {
+            scoped_lock lock( mx_ );
+
+            jobs_.push_back( pb );
+            cn_.notify_one();
+        }
+
+        if( threads_.size() + 1 < depth_ && threads_.size() < blocks_.size() )
+        {
+            try
+            {
+                threads_.push_back( new thread( thread_proc, this ) );
+            }
+            catch( std::exception const & )
+            {
+                // wait() decodes the blocks no thread has taken
+            }
+        }
+    }
+}
+
+// waits for the block 'pb' to be decoded, or decodes it when no thread has started
+void xz_reader::wait( xz_block * pb )
+{
+    bool decode = false;
+
+    {
+        scoped_lock lock( mx_ );
+
+        std::deque< xz_block * >::iterator i = std::find( jobs_.begin(), jobs_.end(), pb );
+
+        if( i != jobs_.end() )
+        {
+            jobs_.erase( i );
+            decode = true;
+        }
+        else
+        {
+            while( !pb->done )
+            {
+                cn_.wait( mx_ );
+            }
+        }
+    }
+
+    if( decode )
+    {
+        try
+        {
+            decode_block( *pb );
+        }
+        catch( std::exception const & x )
+        {
+            pb->error = x.what();
+        }
+
+        pb->done = true;
+    }
+
+    if( !pb->error.empty() )
+    {
+        throw_error( name(), pb->error );
+    }
+}
+
+// completes the block decoded in place, after its data has been returned
+void xz_reader::finish_block( xz_block * pb )
+{
+    if( ( pb->compressed_size >= 0 && pb->compressed_size != pb->consumed ) || ( pb->uncompressed_size >= 0 && pb->uncompressed_size != pb->produced ) )
+    {
+        throw_error( name(), "block size mismatch" );
+    }
+
+    pb->compressed_size = pb->consumed;
+    pb->uncompressed_size = pb->produced;
+
+    read_check( pb );
+
+    if( !check_matches( *pb ) )
+    {
+        throw_error( name(), "integrity check failed" );
+    }
+
+    current_ = 0;
+    delete pb;
+}
+
+// returns the next part of the block being decoded in place, from the
+// dictionary, or false when the block has ended
+bool xz_reader::decode_in_place( void const * & p, std::size_t & n )
+{
+    CLzma2Dec * st = (CLzma2Dec*)state_;
+    xz_block * pb = current_;
+
+    if( out_ == st->decoder.dicPos )
+    {
+        if( pb->done )
+        {
+            finish_block( pb );
+            return false;
+        }
+
+        if( st->decoder.dicPos == st->decoder.dicBufSize )
+        {
+            st->decoder.dicPos = 0;
+        }
+
+        out_ = st->decoder.dicPos;
+
+        while( !pb->done && st->decoder.dicPos == out_ )
+        {
+            if( !refill() )
+            {
+                throw_error( name(), "unexpected end of file" );
+            }
+
+            SizeT m2 = m_;
+
+            ELzmaStatus status = LZMA_STATUS_NOT_SPECIFIED;
+
+            SRes r = Lzma2Dec_DecodeToDic( st, st->decoder.dicBufSize, in_, &m2, LZMA_FINISH_ANY, &status );
+
+            if( r != SZ_OK || ( m2 == 0 && st->decoder.dicPos == out_ && status != LZMA_STATUS_FINISHED_WITH_MARK ) )
+            {
+                throw_error( name(), "LZMA2 data error" );
+            }
+
+            in_ += m2;
+            m_ -= m2;
+
+            pb->consumed += m2;
+
+            if( status == LZMA_STATUS_FINISHED_WITH_MARK )
+            {
+                pb->done = true;
+            }
+        }
+
+        std::size_t k = st->decoder.dicPos - out_;
+
+        update_check( *pb, st->decoder.dic + out_, k );
+        pb->produced += k;
+
+        if( k == 0 )
+        {
+            finish_block( pb );
+            return false;
+        }
+    }
+
+    n = std::min( n, st->decoder.dicPos - out_ );
+
+    p = st->decoder.dic + out_;
+    out_ += n;
+
+    return true;
+}
+
+bool xz_reader::read_direct( void const * & p, std::size_t & n )
+{
+    for( ;; )
+    {
+        if( current_ )
+        {
+            if( decode_in_place( p, n ) )
+            {
+                return true;
+            }
+
+            continue;
+        }
+
+        read_ahead();
+
+        if( current_ )
+        {
+            continue;
+        }
+
+        if( blocks_.empty() )
+        {
+            // EOF
+            p = 0;
+            n = 0;
+
+            return true;
+        }
+
+        xz_block * pb = blocks_.front();
+
+        if( !pb->ready )
+        {
+            wait( pb );
+            pb->ready = true;
+        }
+
+        if( pb->position < pb->output.size() )
+        {
+            n = std::min( n, pb->output.size() - pb->position );
+
+            p = &pb->output[ pb->position ];
+            pb->position += n;
+
+            return true;
+        }
+
+        blocks_.pop_front();
+        delete pb;
+    }
+}
+
+std::size_t xz_reader::read( void * p, std::size_t n )
+{
+    unsigned char * p2 = static_cast< unsigned char* >( p );
+
+    std::size_t r2 = 0;
+
+    while( n > 0 )
+    {
+        void const * p3 = 0;
+        std::size_t n3 = n;
+
+        read_direct( p3, n3 );
+
+        if( n3 == 0 ) break;
+
+        std::memcpy( p2, p3, n3 );
+
+        p2 += n3;
+        n -= n3;
+
+        r2 += n3;
+    }
+
+    return r2;
+}
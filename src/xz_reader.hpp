@@ -0,0 +1,114 @@
+#ifndef XZ_READER_HPP_INCLUDED
+#define XZ_READER_HPP_INCLUDED
+
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "basic_reader.hpp"
+#include "thread.hpp"
+#include <vector>
+#include <deque>
+#include <utility>
+
+struct xz_block;
+
+// decodes the .xz format (LZMA2 filter only) and verifies its checks
+// and index. Blocks whose header stores their sizes, as written by
+// xz -T, are decoded in parallel, by a thread per processor; the
+// others are decoded in place, as they're read
+
+class xz_reader: public basic_reader
+{
+private:
+
+    basic_reader * pr_;
+
+    // input, as in lzma_reader
+
+    static int const N = 65536;
+
+    unsigned char buffer_[ N ];
+
+    unsigned char const * in_;
+    std::size_t m_;
+
+    // the current stream
+
+    unsigned char stream_flags_[ 2 ];
+    int check_;
+
+    // (unpadded size, uncompressed size) of the blocks so far, for
+    // comparison with the index
+    std::vector< std::pair< unsigned long long, unsigned long long > > records_;
+
+    bool eof_;
+
+    // blocks read ahead, in order; the front one is being returned
+    std::deque< xz_block * > blocks_;
+
+    // a block header that has been read, but not yet acted upon
+    xz_block * next_;
+
+    // decoding in place
+
+    void * state_[ 48 ]; // CLzma2Dec
+    bool allocated_;
+
+    xz_block * current_;
+    std::size_t out_;
+
+    // the decoding threads; blocks are read ahead up to one per thread
+    // more than are being decoded, within a limit on their total size
+
+    std::size_t depth_;
+
+    std::vector< thread * > threads_;
+    std::deque< xz_block * > jobs_;
+    bool stop_;
+
+    mutex mx_;
+    condition cn_;
+
+private:
+
+    xz_reader( xz_reader const & );
+    xz_reader& operator=( xz_reader const & );
+
+    static void thread_proc( void * pv );
+    void work();
+
+    bool refill();
+    std::size_t read_input( void * p, std::size_t n );
+    void read_exact( void * p, std::size_t n );
+    unsigned long long read_vli( std::vector< unsigned char > & data );
+
+    bool read_stream_header();
+    void read_index();
+    xz_block * read_block_header();
+
+    void read_ahead();
+    void wait( xz_block * pb );
+    void read_check( xz_block * pb );
+    void finish_block( xz_block * pb );
+
+    bool decode_in_place( void const * & p, std::size_t & n );
+
+public:
+
+    explicit xz_reader( basic_reader * pr );
+
+    ~xz_reader();
+
+    virtual std::string name() const;
+    virtual std::size_t read( void * p, std::size_t n );
+
+    // returns the decoded data in place
+    virtual bool read_direct( void const * & p, std::size_t & n );
+};
+
+#endif // #ifndef XZ_READER_HPP_INCLUDED
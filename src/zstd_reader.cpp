@@ -0,0 +1,137 @@
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "zstd_reader.hpp"
+#include "error.hpp"
+#include "zstd/zstd.h"
+#include <algorithm>
+#include <cstring>
+
+zstd_reader::zstd_reader( basic_reader * pr ): pr_( pr ), ds_( 0 ), in_( 0 ), m_( 0 ), k_( 0 ), n_( 0 ), complete_( false )
+{
+    ds_ = ZSTD_createDStream();
+
+    if( ds_ == 0 )
+    {
+        throw_error( pr_->name(), "could not allocate zstd state" );
+    }
+
+    output_.resize( ZSTD_DStreamOutSize() );
+}
+
+zstd_reader::~zstd_reader()
+{
+    ZSTD_freeDStream( static_cast< ZSTD_DStream* >( ds_ ) );
+}
+
+std::string zstd_reader::name() const
+{
+    return pr_->name();
+}
+
+// decodes the next part of the stream into output_; leaves n_ == 0 at
+// the end of the stream
+
+void zstd_reader::decode()
+{
+    ZSTD_DStream * ds = static_cast< ZSTD_DStream* >( ds_ );
+
+    k_ = n_ = 0;
+
+    while( n_ == 0 )
+    {
+        if( m_ == 0 )
+        {
+            // take the input in place when possible
+
+            void const * p3 = 0;
+            std::size_t r = 1048576;
+
+            if( pr_->read_direct( p3, r ) )
+            {
+                in_ = static_cast< unsigned char const* >( p3 );
+            }
+            else
+            {
+                r = pr_->read( buffer_, N );
+                in_ = buffer_;
+            }
+
+            if( r == 0 )
+            {
+                if( !complete_ )
+                {
+                    throw_error( pr_->name(), "unexpected end of file" );
+                }
+
+                return;
+            }
+
+            m_ = r;
+        }
+
+        ZSTD_inBuffer in = { in_, m_, 0 };
+        ZSTD_outBuffer out = { &output_[ 0 ], output_.size(), 0 };
+
+        std::size_t r = ZSTD_decompressStream( ds, &out, &in );
+
+        if( ZSTD_isError( r ) )
+        {
+            throw_error( pr_->name(), std::string( "zstd data error: " ) + ZSTD_getErrorName( r ) );
+        }
+
+        // r == 0 at the end of a frame; another may follow
+        complete_ = r == 0;
+
+        in_ += in.pos;
+        m_ -= in.pos;
+
+        n_ = out.pos;
+    }
+}
+
+bool zstd_reader::read_direct( void const * & p, std::size_t & n )
+{
+    if( k_ == n_ )
+    {
+        decode();
+    }
+
+    n = std::min( n, n_ - k_ );
+
+    p = &output_[ k_ ];
+    k_ += n;
+
+    return true;
+}
+
+std::size_t zstd_reader::read( void * p, std::size_t n )
+{
+    unsigned char * p2 = static_cast< unsigned char* >( p );
+
+    std::size_t r2 = 0;
+
+    while( n > 0 )
+    {
+        void const * p3 = 0;
+        std::size_t n3 = n;
+
+        read_direct( p3, n3 );
+
+        if( n3 == 0 ) break;
+
+        std::memcpy( p2, p3, n3 );
+
+        p2 += n3;
+        n -= n3;
+
+        r2 += n3;
+    }
+
+    return r2;
+}
@@ -0,0 +1,59 @@
+#ifndef ZSTD_READER_HPP_INCLUDED
+#define ZSTD_READER_HPP_INCLUDED
+
+//
+// Copyright 2026 Peter Dimov
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include "basic_reader.hpp"
+#include <vector>
+
+class zstd_reader: public basic_reader
+{
+private:
+
+    basic_reader * pr_;
+
+    void * ds_; // ZSTD_DStream
+
+    // input, as in lzma_reader
+
+    static int const N = 65536;
+
+    unsigned char buffer_[ N ];
+
+    unsigned char const * in_;
+    std::size_t m_;
+
+    // decoded data, and the part of it that hasn't been returned
+    std::vector< unsigned char > output_;
+    std::size_t k_, n_;
+
+    // whether the last frame is complete; there must be at least one
+    bool complete_;
+
+private:
+
+    zstd_reader( zstd_reader const & );
+    zstd_reader& operator=( zstd_reader const & );
+
+    void decode();
+
+public:
+
+    explicit zstd_reader( basic_reader * pr );
+
+    ~zstd_reader();
+
+    virtual std::string name() const;
+    virtual std::size_t read( void * p, std::size_t n );
+
+    // returns the decoded data in place
+    virtual bool read_direct( void const * & p, std::size_t & n );
+};
+
+#endif // #ifndef ZSTD_READER_HPP_INCLUDED